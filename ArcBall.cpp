@@ -235,6 +235,16 @@ ArcBall::Value(float m[4][4])
     Copy( m, mNow );
 }
 
+// Same rotation as a glm matrix, both are column major
+glm::mat4
+ArcBall::Value( void ) const
+{
+    return glm::mat4( mNow[0][0], mNow[0][1], mNow[0][2], mNow[0][3],
+                      mNow[1][0], mNow[1][1], mNow[1][2], mNow[1][3],
+                      mNow[2][0], mNow[2][1], mNow[2][2], mNow[2][3],
+                      mNow[3][0], mNow[3][1], mNow[3][2], mNow[3][3] );
+}
+
 // Begin drag sequence
 void
 ArcBall::BeginDrag( void )
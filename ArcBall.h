@@ -28,6 +28,7 @@ public:
     void HideResult( void );
     void Update( void );
     void Value(float mNow[4][4]);
+    glm::mat4 Value( void ) const;
     void BeginDrag( void );
     void EndDrag( void );
     void BeginTrans( void );
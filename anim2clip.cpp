@@ -0,0 +1,90 @@
+// Converts a .anim text clip to the binary clip format read by ClipFile.
+// With -additive the keys are first turned into deltas against the rig's
+// reference pose, or against the clip's own pose at the given frame.
+// The written clip is read back and checked against the text clip.
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include "rig.h"
+#include "animation.h"
+#include "clipfile.h"
+#include "blend.h"
+
+static bool sameFrames(const BoneFrame *a, const BoneFrame *b, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        if (a[i].length != b[i].length || a[i].rot.x != b[i].rot.x ||
+                a[i].rot.y != b[i].rot.y || a[i].rot.z != b[i].rot.z ||
+                a[i].rot.w != b[i].rot.w)
+            return false;
+    }
+    return true;
+}
+
+// Every key must survive exactly, and sampling must match in between keys
+static bool verifyClip(const std::string &filename, const Animation &anim, const Rig &rig)
+{
+    ClipFile clip;
+    if (!clip.open(filename))
+        return false;
+    clip.bind(rig);
+
+    Animation readback = clip.toAnimation();
+    if (readback.name != anim.name || readback.numframes != anim.numframes ||
+            readback.additive != anim.additive ||
+            readback.keyframes.size() != anim.keyframes.size())
+        return false;
+
+    for (size_t k = 0; k < anim.keyframes.size(); k++)
+    {
+        if (readback.keyframes[k].frame != anim.keyframes[k].frame ||
+                !sameFrames(&readback.keyframes[k].bones[0], &anim.keyframes[k].bones[0],
+                    rig.numBones()))
+            return false;
+    }
+
+    std::vector<BoneFrame> expected(rig.numBones()), actual(rig.numBones());
+    for (float frame = 0.f; frame <= anim.numframes; frame += 0.25f)
+    {
+        samplePose(anim, frame, &expected[0]);
+        clip.samplePose(frame, &actual[0]);
+        if (!sameFrames(&expected[0], &actual[0], rig.numBones()))
+            return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if ((argc != 4 && argc != 5 && argc != 6) ||
+            (argc > 4 && strcmp(argv[4], "-additive") != 0))
+    {
+        std::cerr << "usage: " << argv[0] << " rig in.anim out.clip [-additive [frame]]\n";
+        exit(1);
+    }
+
+    Rig rig;
+    if (!rig.readRig(argv[1]))
+        exit(1);
+    Animation anim = readAnimation(argv[2], rig);
+
+    if (argc == 5)
+        makeAdditive(anim, rig);
+    else if (argc == 6)
+        makeAdditive(anim, static_cast<float>(atof(argv[5])));
+
+    if (!writeClipFile(argv[3], anim, rig))
+        exit(1);
+
+    if (!verifyClip(argv[3], anim, rig))
+    {
+        std::cerr << "Round trip check failed for " << argv[3] << '\n';
+        exit(1);
+    }
+
+    std::cout << "Wrote " << anim.keyframes.size() << " keys of " << rig.numBones()
+        << " bones to " << argv[3] << '\n';
+    return 0;
+}
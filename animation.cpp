@@ -0,0 +1,169 @@
+#include "animation.h"
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+
+BoneFrame readBoneFrame(std::istream &is)
+{
+    BoneFrame bf;
+    glm::vec4 rot;
+    is >> bf.length >> rot.x >> rot.y >> rot.z >> rot[3];
+    if (!is)
+    {
+        std::cerr << "Unable to read BoneFrame\n";
+        exit(1);
+    }
+    bf.rot = axisAngleToQuat(rot);
+
+    return bf;
+}
+
+Animation readAnimation(const std::string &filename, const Rig &rig)
+{
+    Animation anim;
+    Keyframe keyframe;
+
+    std::ifstream file(filename.c_str());
+    if (!file)
+    {
+        std::cerr << "Unable to open animation file: " << filename << '\n';
+        exit(1);
+    }
+
+    file >> anim.name >> anim.numframes;
+    if (!file)
+    {
+        std::cerr << "Unable to read header from animation file: " << filename << '\n';
+        exit(1);
+    }
+
+    std::string line;
+    keyframe.frame = -1;
+    while (std::getline(file, line))
+    {
+        if (line.empty())
+            continue;
+
+        std::stringstream ss(line);
+        std::string name;
+        ss >> name;
+        if (name == "KEYFRAME")
+        {
+            int num;
+            ss >> num;
+            if (!ss)
+            {
+                std::cerr << "Unable to read keyframe line: " << line << '\n';
+                exit(1);
+            }
+
+            if (keyframe.frame >= 0)
+                anim.keyframes.push_back(keyframe);
+            // Bones without a frame keep their reference pose
+            keyframe.frame = num;
+            keyframe.bones = rig.getRefPose();
+        }
+        else
+        {
+            // Bones are only sized once a KEYFRAME line starts a key
+            if (keyframe.frame < 0)
+            {
+                std::cerr << "Bone line before the first keyframe in animation file: "
+                    << filename << '\n';
+                exit(1);
+            }
+
+            int bone = rig.getBoneIndex(name);
+            if (bone < 0)
+            {
+                std::cerr << "Unknown bone '" << name << "' in animation file: " << filename << '\n';
+                exit(1);
+            }
+            keyframe.bones[bone] = readBoneFrame(ss);
+        }
+    }
+
+    if (keyframe.frame < 0)
+    {
+        std::cerr << "No keyframes in animation file: " << filename << '\n';
+        exit(1);
+    }
+    anim.keyframes.push_back(keyframe);
+
+    return anim;
+}
+
+void interpolate(const Keyframe &a, const Keyframe &b, float frame, BoneFrame *out)
+{
+    assert(a.frame <= frame && b.frame >= frame);
+    assert(a.bones.size() == b.bones.size());
+
+    float fact = (frame - a.frame) / (b.frame - a.frame);
+
+    for (size_t i = 0; i < a.bones.size(); i++)
+    {
+        const BoneFrame &af = a.bones[i];
+        const BoneFrame &bf = b.bones[i];
+
+        out[i].rot = glm::normalize(af.rot * (1 - fact) + bf.rot * fact);
+        out[i].length = fact * bf.length + (1 - fact) * af.length;
+    }
+}
+
+void samplePose(const Animation &anim, float frame, BoneFrame *out, AnimCursor *cursor)
+{
+    assert(!anim.keyframes.empty());
+
+    size_t k0, k1;
+    float fact;
+    if (!selectKeys(&anim.keyframes[0], anim.keyframes.size(), anim.numframes, frame,
+                cursor, &k0, &k1, &fact))
+    {
+        const Keyframe &kf = anim.keyframes[k0];
+        std::copy(kf.bones.begin(), kf.bones.end(), out);
+        return;
+    }
+
+    interpolate(anim.keyframes[k0], anim.keyframes[k1], frame, out);
+}
+
+Keyframe getPose(const Animation &anim, int frame, AnimCursor *cursor)
+{
+    // safety check
+    if (anim.keyframes.empty())
+        return Keyframe();
+
+    Keyframe kf;
+    kf.frame = frame;
+    kf.bones.resize(anim.keyframes.front().bones.size());
+    samplePose(anim, frame, &kf.bones[0], cursor);
+
+    return kf;
+}
+
+void dumpAnimation(const Animation &anim, const Rig &rig)
+{
+    // print header
+    std::cout << "outputted_anim\n" << anim.numframes << "\n\n";
+
+    for (size_t i = 0; i < anim.keyframes.size(); i++)
+    {
+        dumpKeyframe(anim.keyframes[i], rig);
+        std::cout << '\n';
+    }
+}
+
+void dumpKeyframe(const Keyframe &kf, const Rig &rig)
+{
+    std::cout << "KEYFRAME " << kf.frame << '\n';
+    for (size_t i = 0; i < kf.bones.size(); i++)
+    {
+        const BoneFrame &bf = kf.bones[i];
+        const glm::vec4 rot = quatToAxisAngle(bf.rot);
+        std::cout << rig.getBoneName(i) << ' ' << bf.length << ' '
+            << rot.x << ' ' << rot.y << ' ' << rot.z << ' ' << rot.w << '\n';
+    }
+}
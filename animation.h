@@ -0,0 +1,117 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "rig.h"
+
+// Bone frames are indexed by bone index, see Rig::getBoneIndex
+struct Keyframe
+{
+    int frame;
+    std::vector<BoneFrame> bones;
+};
+
+struct Animation
+{
+    Animation() : numframes(0), additive(false) {}
+
+    std::string name;
+    int numframes;
+    // Keys are deltas to apply with applyAdditive, see makeAdditive
+    bool additive;
+    std::vector<Keyframe> keyframes;
+};
+
+// Remembers the key pair the last sample landed in.  Playback that moves
+// forward a frame at a time stays in that pair or steps to the next one, so
+// lookups are amortized O(1); any other jump falls back to a binary search.
+// Keep one per playing clip, a stale cursor is slow but never wrong.
+struct AnimCursor
+{
+    AnimCursor() : key(0) {}
+    size_t key;
+};
+
+inline int keyFrameOf(const Keyframe &kf) { return kf.frame; }
+inline int keyFrameOf(int frame) { return frame; }
+
+// True when keys[i - 1] <= frame < keys[i], treating the ends as open
+template <typename Key>
+bool keyBrackets(const Key *keys, size_t numKeys, size_t i, float frame)
+{
+    return i <= numKeys &&
+        (i == 0 || keyFrameOf(keys[i - 1]) <= frame) &&
+        (i == numKeys || frame < keyFrameOf(keys[i]));
+}
+
+// Finds the first key after frame in keys, sorted by frame.  Returns 0 when
+// frame is before the first key and numKeys when it is at or past the last,
+// otherwise frame lies between keys i - 1 and i.  cursor may be NULL.
+template <typename Key>
+size_t findKey(const Key *keys, size_t numKeys, float frame, AnimCursor *cursor)
+{
+    size_t i = cursor ? cursor->key : 0;
+    if (cursor && keyBrackets(keys, numKeys, i, frame))
+        return i;
+
+    if (cursor && keyBrackets(keys, numKeys, i + 1, frame))
+        i++;
+    else
+    {
+        size_t lo = 0, hi = numKeys;
+        while (lo < hi)
+        {
+            size_t mid = lo + (hi - lo) / 2;
+            if (keyFrameOf(keys[mid]) <= frame)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        i = lo;
+    }
+
+    if (cursor)
+        cursor->key = i;
+    return i;
+}
+
+// Picks the keys a sample at frame blends, shared by every clip type.
+// There is no looping: frames before the first key hold the first key,
+// frames at or past the last key or numframes hold the last.  Returns false
+// when a single key *i0 is held, otherwise frame lies between keys *i0 and
+// *i1 = *i0 + 1, a fraction *t of the way.
+template <typename Key>
+bool selectKeys(const Key *keys, size_t numKeys, int numframes, float frame,
+        AnimCursor *cursor, size_t *i0, size_t *i1, float *t)
+{
+    size_t i = numKeys;
+    if (frame < numframes)
+        i = findKey(keys, numKeys, frame, cursor);
+
+    if (i == 0 || i == numKeys)
+    {
+        *i0 = *i1 = i == 0 ? 0 : numKeys - 1;
+        *t = 0.f;
+        return false;
+    }
+
+    const int f0 = keyFrameOf(keys[i - 1]), f1 = keyFrameOf(keys[i]);
+    *i0 = i - 1;
+    *i1 = i;
+    *t = (frame - f0) / (f1 - f0);
+    return true;
+}
+
+// Reads a .anim file, bone names are resolved against rig.  Bones without a
+// frame in a keyframe keep the rig's reference pose.
+Animation readAnimation(const std::string &filename, const Rig &rig);
+void dumpAnimation(const Animation &anim, const Rig &rig);
+void dumpKeyframe(const Keyframe &kf, const Rig &rig);
+
+// Writes the interpolated pose at frame to out, one BoneFrame per bone.
+// Frames before the first key hold the first key, frames after the last
+// key or past numframes hold the last.  anim must have at least one
+// keyframe, sorted by frame.
+void samplePose(const Animation &anim, float frame, BoneFrame *out,
+        AnimCursor *cursor = NULL);
+void interpolate(const Keyframe &a, const Keyframe &b, float frame, BoneFrame *out);
+Keyframe getPose(const Animation &anim, int frame, AnimCursor *cursor = NULL);
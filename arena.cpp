@@ -0,0 +1,130 @@
+#include "arena.h"
+#include <cassert>
+#include <cstdlib>
+#include <algorithm>
+#include <stdint.h>
+
+FrameArena::FrameArena(size_t blockSize) :
+    blockSize_(blockSize), current_(0), offset_(0), used_(0)
+{
+}
+
+FrameArena::~FrameArena()
+{
+    for (size_t i = 0; i < blocks_.size(); i++)
+        ::free(blocks_[i].data);
+}
+
+void *FrameArena::allocate(size_t bytes, size_t align)
+{
+    assert(align && (align & (align - 1)) == 0);
+
+    // Move through the blocks kept from earlier frames before growing
+    for (;;)
+    {
+        if (current_ < blocks_.size())
+        {
+            Block &block = blocks_[current_];
+            uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+            size_t start = ((base + offset_ + align - 1) & ~(align - 1)) - base;
+            if (start + bytes <= block.size)
+            {
+                offset_ = start + bytes;
+                used_ += bytes;
+                return block.data + start;
+            }
+
+            if (current_ + 1 < blocks_.size())
+            {
+                current_++;
+                offset_ = 0;
+                continue;
+            }
+        }
+
+        Block block;
+        block.size = std::max(blockSize_, bytes + align);
+        block.data = static_cast<char *>(malloc(block.size));
+        assert(block.data);
+        blocks_.push_back(block);
+        current_ = blocks_.size() - 1;
+        offset_ = 0;
+    }
+}
+
+void FrameArena::reset()
+{
+    current_ = 0;
+    offset_ = 0;
+    used_ = 0;
+}
+
+size_t FrameArena::capacity() const
+{
+    size_t total = 0;
+    for (size_t i = 0; i < blocks_.size(); i++)
+        total += blocks_[i].size;
+    return total;
+}
+
+// Alignment of T, found from the padding a struct puts in front of it
+template <typename T>
+struct AlignOf
+{
+    struct Probe { char c; T t; };
+    enum { value = sizeof(Probe) - sizeof(T) };
+};
+
+PosePool::PosePool(size_t numBones, size_t posesPerChunk) :
+    numBones_(numBones), posesPerChunk_(posesPerChunk), freeList_(NULL), allocated_(0)
+{
+    assert(numBones_ > 0 && posesPerChunk_ > 0);
+    // Round up so every buffer in a chunk can hold a FreeNode or a pose
+    size_t align = std::max<size_t>(AlignOf<FreeNode>::value, AlignOf<BoneFrame>::value);
+    poseBytes_ = std::max(numBones_ * sizeof(BoneFrame), sizeof(FreeNode));
+    poseBytes_ = (poseBytes_ + align - 1) & ~(align - 1);
+}
+
+PosePool::~PosePool()
+{
+    for (size_t i = 0; i < chunks_.size(); i++)
+        ::free(chunks_[i]);
+}
+
+void PosePool::addChunk()
+{
+    char *chunk = static_cast<char *>(malloc(poseBytes_ * posesPerChunk_));
+    assert(chunk);
+    chunks_.push_back(chunk);
+
+    // Link back to front so poses are handed out in address order
+    for (size_t i = posesPerChunk_; i > 0; i--)
+    {
+        FreeNode *node = reinterpret_cast<FreeNode *>(chunk + (i - 1) * poseBytes_);
+        node->next = freeList_;
+        freeList_ = node;
+    }
+}
+
+BoneFrame *PosePool::allocate()
+{
+    if (!freeList_)
+        addChunk();
+
+    FreeNode *node = freeList_;
+    freeList_ = node->next;
+    allocated_++;
+    return reinterpret_cast<BoneFrame *>(node);
+}
+
+void PosePool::free(BoneFrame *pose)
+{
+    if (!pose)
+        return;
+
+    assert(allocated_ > 0);
+    FreeNode *node = reinterpret_cast<FreeNode *>(pose);
+    node->next = freeList_;
+    freeList_ = node;
+    allocated_--;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include "rig.h"
+
+// Bump allocator for data that only lives for one frame, such as scratch
+// poses and palettes.  reset() at the start of each frame releases
+// everything at once and keeps the memory, so once the arena has grown to
+// a frame's peak it never calls malloc again.  Not thread safe, use one
+// per thread.  Nothing allocated here has its destructor run.
+class FrameArena
+{
+public:
+    explicit FrameArena(size_t blockSize = 1 << 20);
+    ~FrameArena();
+
+    void *allocate(size_t bytes, size_t align = 16);
+
+    template <typename T>
+    T *allocate(size_t count)
+    {
+        return static_cast<T *>(allocate(count * sizeof(T)));
+    }
+
+    void reset();
+
+    // Bytes handed out since the last reset
+    size_t bytesUsed() const { return used_; }
+    size_t capacity() const;
+
+private:
+    struct Block
+    {
+        char *data;
+        size_t size;
+    };
+
+    size_t blockSize_;
+    std::vector<Block> blocks_;
+    // block being allocated from and the offset into it
+    size_t current_;
+    size_t offset_;
+    size_t used_;
+
+    // Not copyable
+    FrameArena(const FrameArena &);
+    FrameArena &operator=(const FrameArena &);
+};
+
+// Fixed size pose buffers for longer lived per instance storage.  Buffers
+// are carved out of chunks of posesPerChunk poses and recycled through a
+// free list, so allocate and free are O(1) and only a new chunk touches
+// the heap.  Buffers stay valid until they are freed or the pool dies.
+class PosePool
+{
+public:
+    explicit PosePool(size_t numBones, size_t posesPerChunk = 64);
+    ~PosePool();
+
+    size_t numBones() const { return numBones_; }
+
+    // numBones() uninitialized BoneFrames
+    BoneFrame *allocate();
+    void free(BoneFrame *pose);
+
+    size_t numAllocated() const { return allocated_; }
+
+private:
+    // Freed buffers are linked through their own storage
+    struct FreeNode
+    {
+        FreeNode *next;
+    };
+
+    size_t numBones_;
+    size_t posesPerChunk_;
+    size_t poseBytes_;
+    std::vector<char *> chunks_;
+    FreeNode *freeList_;
+    size_t allocated_;
+
+    void addChunk();
+
+    // Not copyable
+    PosePool(const PosePool &);
+    PosePool &operator=(const PosePool &);
+};
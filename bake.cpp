@@ -0,0 +1,357 @@
+// Bakes clips to per sample poses without a display, for asset pipelines.
+// Every clip is sampled rate times per frame from frame 0 to its last
+// frame, and each sample is written as one model space matrix or one local
+// transform per bone.  Samples are evaluated a window at a time on every
+// core and streamed out in order, so memory stays bounded however long the
+// clips are.  Each window is written while the next one is evaluated.
+// Binary .clip inputs are sampled straight from their mapping.
+//
+// Output format, native endian, every field 4 byte aligned:
+//   BakeFileHeader
+//   char           boneNames[stringTableSize]   NUL terminated, bone order
+//   then per clip, in command line order:
+//     BakeClipHeader
+//     char         name[nameSize]               NUL terminated, padded
+//     float        samples[numSamples][numBones][16 or 5]
+// A matrix is 16 floats column major, a local transform is length, x,y,z,w
+// as in the clip format.
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <stdint.h>
+#include <pthread.h>
+#include "rig.h"
+#include "animation.h"
+#include "clipfile.h"
+#include "blend.h"
+#include "jobs.h"
+
+static const char BAKE_MAGIC[4] = { 'K', 'S', 'B', 'K' };
+static const uint32_t BAKE_VERSION = 1;
+
+struct BakeFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t numBones;
+    uint32_t numClips;
+    uint32_t flags;
+    float rate;
+    uint32_t stringTableSize;
+};
+
+struct BakeClipHeader
+{
+    uint32_t numSamples;
+    uint32_t flags;
+    uint32_t nameSize;
+};
+
+enum BakeFlags
+{
+    // file: samples are matrices rather than local transforms
+    BAKE_MATRICES = 1,
+    // clip: the source clip was additive, matrices have it applied to the
+    // reference pose, local transforms are the raw deltas
+    BAKE_ADDITIVE = 2
+};
+
+// Samples evaluated before each write, bounds the output buffer
+static const size_t WINDOW_SAMPLES = 1024;
+static const size_t SAMPLE_GRAIN = 8;
+
+// A clip to bake, either mapped binary or parsed text
+struct BakeClip
+{
+    std::string filename;
+    ClipFile clip;
+    Animation anim;
+    bool binary;
+    // index of the clip's first sample among every clip's samples
+    size_t firstSample;
+    size_t numSamples;
+
+    const char *getName() const { return binary ? clip.getName() : anim.name.c_str(); }
+    bool isAdditive() const { return binary ? clip.isAdditive() : anim.additive; }
+    int numFrames() const { return binary ? clip.numFrames() : anim.numframes; }
+    size_t numKeys() const { return binary ? clip.numKeys() : anim.keyframes.size(); }
+
+    void samplePose(float frame, BoneFrame *out, AnimCursor *cursor) const
+    {
+        if (binary)
+            clip.samplePose(frame, out, cursor);
+        else
+            ::samplePose(anim, frame, out, cursor);
+    }
+};
+
+struct BakeJob
+{
+    const Rig *rig;
+    const std::vector<BakeClip *> *clips;
+    float rate;
+    bool matrices;
+    // first sample of the current window
+    size_t windowStart;
+    // sample size in floats, and the window's output
+    size_t sampleFloats;
+    float *output;
+    // scratch pose for each job thread
+    BoneFrame *poses;
+};
+
+static void bakeSamples(void *data, size_t begin, size_t end)
+{
+    const BakeJob &job = *static_cast<BakeJob *>(data);
+    const Rig &rig = *job.rig;
+    const std::vector<BakeClip *> &clips = *job.clips;
+    const size_t numBones = rig.numBones();
+
+    BoneFrame *pose = job.poses + JobSystem::threadIndex() * numBones;
+    AnimCursor cursor;
+    int current = -1;
+
+    for (size_t i = begin; i < end; i++)
+    {
+        const size_t sample = job.windowStart + i;
+
+        // Chunks are contiguous, so the clip only changes at its boundaries
+        if (current < 0 || sample >= clips[current]->firstSample + clips[current]->numSamples)
+        {
+            size_t c = current < 0 ? 0 : current;
+            while (sample >= clips[c]->firstSample + clips[c]->numSamples)
+                c++;
+            current = c;
+            cursor = AnimCursor();
+        }
+        const BakeClip &clip = *clips[current];
+
+        const float frame = (sample - clip.firstSample) / job.rate;
+        clip.samplePose(frame, pose, &cursor);
+
+        float *out = job.output + i * job.sampleFloats;
+        if (!job.matrices)
+        {
+            for (size_t b = 0; b < numBones; b++, out += 5)
+            {
+                out[0] = pose[b].length;
+                out[1] = pose[b].rot.x;
+                out[2] = pose[b].rot.y;
+                out[3] = pose[b].rot.z;
+                out[4] = pose[b].rot.w;
+            }
+            continue;
+        }
+
+        if (clip.isAdditive())
+            applyAdditive(&rig.getRefPose()[0], pose, numBones, 1.f, NULL, pose);
+        // Matrices are written in place, each built from its parent's entry
+        rig.computePalette(pose, glm::mat4(1.f), reinterpret_cast<glm::mat4 *>(out));
+    }
+}
+
+// Writes one evaluated window, with each clip's header where it starts.
+// Runs on its own thread while the jobs evaluate the next window.
+struct BakeWriter
+{
+    std::ofstream *file;
+    const std::vector<BakeClip *> *clips;
+    size_t sampleFloats;
+    // next clip whose header is due
+    size_t nextClip;
+    // the window to write
+    size_t windowStart;
+    size_t count;
+    const float *output;
+};
+
+static std::string padStrings(std::string strings)
+{
+    while (strings.size() % 4)
+        strings += '\0';
+    return strings;
+}
+
+static void *writeWindow(void *data)
+{
+    BakeWriter &writer = *static_cast<BakeWriter *>(data);
+    const std::vector<BakeClip *> &clips = *writer.clips;
+    std::ofstream &file = *writer.file;
+
+    size_t written = 0;
+    while (written < writer.count)
+    {
+        size_t run = writer.count - written;
+        if (writer.nextClip < clips.size())
+        {
+            const BakeClip &clip = *clips[writer.nextClip];
+            if (clip.firstSample == writer.windowStart + written)
+            {
+                const std::string name = padStrings(std::string(clip.getName()) + '\0');
+                BakeClipHeader ch;
+                ch.numSamples = clip.numSamples;
+                ch.flags = clip.isAdditive() ? BAKE_ADDITIVE : 0;
+                ch.nameSize = name.size();
+                file.write(reinterpret_cast<const char *>(&ch), sizeof(ch));
+                file.write(name.data(), name.size());
+                writer.nextClip++;
+                continue;
+            }
+            run = std::min(run, clip.firstSample - (writer.windowStart + written));
+        }
+        file.write(reinterpret_cast<const char *>(writer.output + written * writer.sampleFloats),
+                run * writer.sampleFloats * sizeof(float));
+        written += run;
+    }
+
+    return NULL;
+}
+
+static void usage(const char *argv0)
+{
+    std::cerr << "usage: " << argv0
+        << " [-rate samples_per_frame] [-local] [-threads n] rig out.bake clip...\n";
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    float rate = 1.f;
+    bool matrices = true;
+    int threads = 0;
+
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++)
+    {
+        if (strcmp(argv[arg], "-rate") == 0 && arg + 1 < argc)
+            rate = static_cast<float>(atof(argv[++arg]));
+        else if (strcmp(argv[arg], "-local") == 0)
+            matrices = false;
+        else if (strcmp(argv[arg], "-threads") == 0 && arg + 1 < argc)
+            threads = atoi(argv[++arg]);
+        else
+            usage(argv[0]);
+    }
+    if (argc - arg < 3 || rate <= 0.f)
+        usage(argv[0]);
+
+    Rig rig;
+    if (!rig.readRig(argv[arg]))
+        exit(1);
+    const std::string outname = argv[arg + 1];
+    const size_t numBones = rig.numBones();
+
+    // Lay every clip's samples end to end, jobs index into that sequence
+    std::vector<BakeClip *> clips;
+    size_t totalSamples = 0;
+    for (int a = arg + 2; a < argc; a++)
+    {
+        BakeClip *clip = new BakeClip();
+        clip->filename = argv[a];
+        clip->binary = hasClipExtension(clip->filename);
+        if (clip->binary)
+        {
+            if (!clip->clip.open(clip->filename))
+                exit(1);
+            clip->clip.bind(rig);
+        }
+        else
+            clip->anim = readAnimation(clip->filename, rig);
+        // Sampling asserts on an empty clip, and would do so on a job thread
+        if (clip->numKeys() == 0)
+        {
+            std::cerr << "No keys in clip: " << clip->filename << '\n';
+            exit(1);
+        }
+
+        clip->firstSample = totalSamples;
+        clip->numSamples = static_cast<size_t>(std::max(clip->numFrames(), 0) * rate) + 1;
+        totalSamples += clip->numSamples;
+        clips.push_back(clip);
+    }
+
+    std::ofstream file(outname.c_str(), std::ios::binary);
+    if (!file)
+    {
+        std::cerr << "Unable to open " << outname << " for writing\n";
+        exit(1);
+    }
+
+    std::string boneNames;
+    for (size_t b = 0; b < numBones; b++)
+    {
+        boneNames += rig.getBoneName(b);
+        boneNames += '\0';
+    }
+    boneNames = padStrings(boneNames);
+
+    BakeFileHeader header;
+    memcpy(header.magic, BAKE_MAGIC, sizeof(BAKE_MAGIC));
+    header.version = BAKE_VERSION;
+    header.numBones = numBones;
+    header.numClips = clips.size();
+    header.flags = matrices ? BAKE_MATRICES : 0;
+    header.rate = rate;
+    header.stringTableSize = boneNames.size();
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(boneNames.data(), boneNames.size());
+
+    JobSystem jobs(threads);
+    const size_t sampleFloats = numBones * (matrices ? 16 : 5);
+    // Two windows, one being written while the other is evaluated
+    std::vector<float> output[2];
+    output[0].resize(WINDOW_SAMPLES * sampleFloats);
+    output[1].resize(WINDOW_SAMPLES * sampleFloats);
+    std::vector<BoneFrame> poses(jobs.numThreads() * numBones);
+
+    BakeJob job;
+    job.rig = &rig;
+    job.clips = &clips;
+    job.rate = rate;
+    job.matrices = matrices;
+    job.sampleFloats = sampleFloats;
+    job.poses = &poses[0];
+
+    BakeWriter writer;
+    writer.file = &file;
+    writer.clips = &clips;
+    writer.sampleFloats = sampleFloats;
+    writer.nextClip = 0;
+
+    pthread_t writerThread;
+    bool writing = false;
+    for (size_t start = 0, w = 0; start < totalSamples; start += WINDOW_SAMPLES, w ^= 1)
+    {
+        const size_t count = std::min(WINDOW_SAMPLES, totalSamples - start);
+        job.windowStart = start;
+        job.output = &output[w][0];
+        jobs.parallelFor(count, SAMPLE_GRAIN, bakeSamples, &job);
+
+        // Windows go out in order, and once the last one is written its
+        // buffer is free for the next window
+        if (writing)
+            pthread_join(writerThread, NULL);
+        writer.windowStart = start;
+        writer.count = count;
+        writer.output = job.output;
+        pthread_create(&writerThread, NULL, writeWindow, &writer);
+        writing = true;
+    }
+    if (writing)
+        pthread_join(writerThread, NULL);
+
+    for (size_t c = 0; c < clips.size(); c++)
+        delete clips[c];
+
+    if (!file)
+    {
+        std::cerr << "Error writing " << outname << '\n';
+        exit(1);
+    }
+    std::cout << "Baked " << totalSamples << " samples of " << numBones << " bones from "
+        << header.numClips << " clips to " << outname << " on " << jobs.numThreads()
+        << " threads\n";
+    return 0;
+}
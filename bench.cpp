@@ -0,0 +1,523 @@
+// Timings for each stage of the animation path, on the shipped test rig and
+// on generated medium and large rigs.  Every stage reports ns per bone and
+// instances per second, where an instance is one whole pose (or rig, clip,
+// chain) processed.  Built with optimization by the bench make target, run
+// it before and after a change to the evaluation code.
+//
+//   bench [-scale s]     s multiplies the iteration counts, default 1
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <unistd.h>
+#include <time.h>
+#include "rig.h"
+#include "animation.h"
+#include "clipfile.h"
+#include "sampler.h"
+#include "spline.h"
+#include "compress.h"
+#include "blend.h"
+#include "crowd.h"
+#include "ik.h"
+#include "jobs.h"
+#include "bonebatch.h"
+
+// Iterations are sized so each stage touches about this many bones
+static const double BONES_PER_STAGE = 4e6;
+static const size_t CROWD_SIZE = 256;
+static const int NUM_KEYS = 16;
+static const int NUM_FRAMES = 300;
+
+static double scale = 1.0;
+// Results feed this so the optimizer can't drop the timed work
+static volatile float sink;
+
+static double now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static size_t iterations(size_t bonesPerIteration)
+{
+    const double n = BONES_PER_STAGE * scale / bonesPerIteration;
+    return n < 4 ? 4 : static_cast<size_t>(n);
+}
+
+static void report(const char *stage, const char *rig, size_t numBones,
+        size_t instances, double seconds)
+{
+    printf("%-20s %-8s %5zu bones %10.2f ns/bone %12.0f inst/s\n", stage, rig, numBones,
+            seconds * 1e9 / (instances * numBones), instances / seconds);
+}
+
+// For stages whose cost doesn't depend on the bone count
+static void reportLookups(const char *stage, const char *rig, size_t lookups, double seconds)
+{
+    printf("%-20s %-8s %11s %10.2f ns/lookup %10.0f lookups/s\n", stage, rig, "",
+            seconds * 1e9 / lookups, lookups / seconds);
+}
+
+// A spine of segments bones, each with a left and right limb of limbLength
+static void writeTestRig(const std::string &filename, int segments, int limbLength)
+{
+    std::ofstream file(filename.c_str());
+    file << "root 0 0 0 0 0 1 90 0 NULL\n";
+    std::string parent = "root";
+    for (int s = 0; s < segments; s++)
+    {
+        std::stringstream spine;
+        spine << "spine" << s;
+        file << spine.str() << " 0 0 0 0 0 1 0 .2 " << parent << '\n';
+        for (int side = -1; side <= 1; side += 2)
+        {
+            std::string limbParent = spine.str();
+            for (int k = 0; k < limbLength; k++)
+            {
+                std::stringstream limb;
+                limb << spine.str() << (side < 0 ? "_r" : "_l") << k;
+                file << limb.str() << ' ' << (k ? "0 0 0" : "0 0.1 0") << " 0 0 1 "
+                    << (k ? 10 * side : 90 * side) << " .1 " << limbParent << '\n';
+                limbParent = limb.str();
+            }
+        }
+        parent = spine.str();
+    }
+}
+
+static float randf(float lo, float hi)
+{
+    return lo + (hi - lo) * (rand() / static_cast<float>(RAND_MAX));
+}
+
+// NUM_KEYS keys of random rotations spread over NUM_FRAMES frames
+static void writeTestAnim(const std::string &filename, const Rig &rig)
+{
+    std::ofstream file(filename.c_str());
+    file << "bench_anim\n" << NUM_FRAMES << "\n\n";
+    for (int k = 0; k < NUM_KEYS; k++)
+    {
+        file << "KEYFRAME " << k * NUM_FRAMES / (NUM_KEYS - 1) << '\n';
+        for (size_t b = 0; b < rig.numBones(); b++)
+        {
+            const glm::vec3 axis = glm::normalize(glm::vec3(randf(-1, 1), randf(-1, 1), 1.f));
+            file << rig.getBoneName(b) << ' ' << rig.getRefPose()[b].length << ' '
+                << axis.x << ' ' << axis.y << ' ' << axis.z << ' ' << randf(-45, 45) << '\n';
+        }
+        file << '\n';
+    }
+}
+
+// Frames stepped through by the sampling stages, a fraction off whole
+// frames so every sample interpolates
+static float nextFrame(float frame, float numFrames)
+{
+    frame += 0.37f;
+    return frame > numFrames ? frame - numFrames : frame;
+}
+
+static void benchLoading(const char *name, const std::string &bonesFile,
+        const std::string &animFile)
+{
+    Rig rig;
+    rig.readRig(bonesFile);
+    const size_t numBones = rig.numBones();
+
+    char rigFile[] = "/tmp/benchrigXXXXXX";
+    char clipFile[] = "/tmp/benchclipXXXXXX";
+    close(mkstemp(rigFile));
+    close(mkstemp(clipFile));
+    rig.writeRig(rigFile);
+    writeClipFile(clipFile, readAnimation(animFile, rig), rig);
+
+    size_t n = iterations(numBones * 50);
+    double start = now();
+    for (size_t i = 0; i < n; i++)
+    {
+        Rig r;
+        r.readRig(bonesFile);
+        sink = sink + r.numBones();
+    }
+    report("load .bones", name, numBones, n, now() - start);
+
+    start = now();
+    for (size_t i = 0; i < n; i++)
+    {
+        Rig r;
+        r.readRig(rigFile);
+        sink = sink + r.numBones();
+    }
+    report("load binary rig", name, numBones, n, now() - start);
+
+    n = iterations(numBones * NUM_KEYS * 20);
+    start = now();
+    for (size_t i = 0; i < n; i++)
+    {
+        Animation anim = readAnimation(animFile, rig);
+        sink = sink + anim.keyframes.size();
+    }
+    report("load .anim", name, numBones, n, now() - start);
+
+    n = iterations(numBones * 2);
+    start = now();
+    for (size_t i = 0; i < n; i++)
+    {
+        ClipFile clip;
+        clip.open(clipFile);
+        clip.bind(rig);
+        sink = sink + clip.numKeys();
+    }
+    report("open+bind .clip", name, numBones, n, now() - start);
+
+    unlink(rigFile);
+    unlink(clipFile);
+}
+
+static void benchLookup(const char *name, const Animation &anim)
+{
+    const size_t n = iterations(1);
+    const float numFrames = anim.numframes;
+
+    float frame = 0.f;
+    double start = now();
+    for (size_t i = 0; i < n; i++)
+    {
+        sink = sink + findKey(&anim.keyframes[0], anim.keyframes.size(), frame, NULL);
+        frame = nextFrame(frame, numFrames);
+    }
+    reportLookups("findKey search", name, n, now() - start);
+
+    AnimCursor cursor;
+    frame = 0.f;
+    start = now();
+    for (size_t i = 0; i < n; i++)
+    {
+        sink = sink + findKey(&anim.keyframes[0], anim.keyframes.size(), frame, &cursor);
+        frame = nextFrame(frame, numFrames);
+    }
+    reportLookups("findKey cursor", name, n, now() - start);
+}
+
+// Times one clip representation's samplePose with a cursor
+template <class Clip>
+static void benchClip(const char *stage, const char *name, const Clip &clip,
+        size_t numBones, float numFrames)
+{
+    std::vector<BoneFrame> pose(numBones);
+    const size_t n = iterations(numBones);
+    AnimCursor cursor;
+    float frame = 0.f;
+
+    const double start = now();
+    for (size_t i = 0; i < n; i++)
+    {
+        clip.samplePose(frame, &pose[0], &cursor);
+        sink = sink + pose[numBones - 1].rot.x;
+        frame = nextFrame(frame, numFrames);
+    }
+    report(stage, name, numBones, n, now() - start);
+}
+
+// Adapts the free samplePose to benchClip
+struct AnimationClip
+{
+    const Animation &anim;
+    explicit AnimationClip(const Animation &anim) : anim(anim) {}
+    void samplePose(float frame, BoneFrame *out, AnimCursor *cursor) const
+    {
+        ::samplePose(anim, frame, out, cursor);
+    }
+};
+
+static void benchSampling(const char *name, const Rig &rig, const Animation &anim)
+{
+    const size_t numBones = rig.numBones();
+    const float numFrames = anim.numframes;
+
+    benchClip("sample Animation", name, AnimationClip(anim), numBones, numFrames);
+
+    PoseSampler sampler;
+    sampler.build(anim);
+    benchClip("sample PoseSampler", name, sampler, numBones, numFrames);
+
+    SplineClip spline;
+    spline.build(anim);
+    benchClip("sample SplineClip", name, spline, numBones, numFrames);
+
+    CompressedClip compressed;
+    if (!compressed.compress(anim, rig, 1e-3f))
+    {
+        std::cerr << "Compression missed its error bound: "
+            << compressed.getMeasuredError() << '\n';
+        exit(1);
+    }
+    benchClip("sample Compressed", name, compressed, numBones, numFrames);
+
+    char clipFile[] = "/tmp/benchclipXXXXXX";
+    close(mkstemp(clipFile));
+    writeClipFile(clipFile, anim, rig);
+    ClipFile clip;
+    clip.open(clipFile);
+    clip.bind(rig);
+    benchClip("sample ClipFile", name, clip, numBones, numFrames);
+    unlink(clipFile);
+}
+
+static void benchBlending(const char *name, const Rig &rig, const Animation &anim)
+{
+    const size_t numBones = rig.numBones();
+    std::vector<BoneFrame> a(numBones), b(numBones), out(numBones);
+    samplePose(anim, 10.5f, &a[0]);
+    samplePose(anim, 200.5f, &b[0]);
+
+    std::vector<float> mask(numBones);
+    buildSubtreeMask(rig, numBones > 1 ? 1 : 0, 1.f, &mask[0]);
+
+    const size_t n = iterations(numBones);
+    double start = now();
+    for (size_t i = 0; i < n; i++)
+    {
+        blendPoses(&a[0], &b[0], numBones, 0.3f, NULL, &out[0]);
+        sink = sink + out[numBones - 1].rot.x;
+    }
+    report("blendPoses", name, numBones, n, now() - start);
+
+    start = now();
+    for (size_t i = 0; i < n; i++)
+    {
+        blendPoses(&a[0], &b[0], numBones, 0.3f, &mask[0], &out[0]);
+        sink = sink + out[numBones - 1].rot.x;
+    }
+    report("blendPoses masked", name, numBones, n, now() - start);
+
+    start = now();
+    for (size_t i = 0; i < n; i++)
+    {
+        applyAdditive(&a[0], &b[0], numBones, 0.5f, NULL, &out[0]);
+        sink = sink + out[numBones - 1].rot.x;
+    }
+    report("applyAdditive", name, numBones, n, now() - start);
+}
+
+static void benchPalette(const char *name, const Rig &rig, const Animation &anim)
+{
+    const size_t numBones = rig.numBones();
+    std::vector<BoneFrame> pose(numBones);
+    std::vector<glm::mat4> palette(numBones);
+    samplePose(anim, 10.5f, &pose[0]);
+
+    const size_t n = iterations(numBones);
+    const double start = now();
+    for (size_t i = 0; i < n; i++)
+    {
+        rig.computePalette(&pose[0], glm::mat4(1.f), &palette[0]);
+        sink = sink + palette[numBones - 1][3].x;
+    }
+    report("computePalette", name, numBones, n, now() - start);
+}
+
+static void benchCrowd(const char *name, const Rig &rig, const Animation &anim,
+        JobSystem &jobs)
+{
+    const size_t numBones = rig.numBones();
+    PoseSampler sampler;
+    sampler.build(anim);
+
+    Crowd crowd(&rig);
+    crowd.resize(CROWD_SIZE);
+    for (size_t i = 0; i < crowd.size(); i++)
+    {
+        crowd.getInstance(i).sampler = &sampler;
+        crowd.getInstance(i).frame = (i * 7) % anim.numframes + 0.5f;
+    }
+
+    const size_t n = iterations(numBones * CROWD_SIZE);
+    double start = now();
+    for (size_t i = 0; i < n; i++)
+        crowd.evaluate();
+    report("crowd evaluate", name, numBones, n * CROWD_SIZE, now() - start);
+
+    start = now();
+    for (size_t i = 0; i < n; i++)
+        crowd.evaluate(jobs);
+    report("crowd evaluate jobs", name, numBones, n * CROWD_SIZE, now() - start);
+    sink = sink + crowd.getPalette(CROWD_SIZE - 1)[numBones - 1][3].x;
+
+    // One limb per instance pulled towards its own base, as foot planting
+    const int effector = numBones - 1;
+    std::vector<CrowdLimb> limbs(CROWD_SIZE);
+    for (size_t i = 0; i < CROWD_SIZE; i++)
+    {
+        const glm::vec3 base(crowd.getPalette(i)[rig.getParent(effector)][3]);
+        limbs[i].instance = i;
+        limbs[i].effector = effector;
+        limbs[i].target = base + glm::vec3(0.f, 0.f, 0.1f);
+        limbs[i].pole = base + glm::vec3(0.f, 1.f, 0.f);
+    }
+    start = now();
+    for (size_t i = 0; i < n; i++)
+        crowd.solveTwoBone(&limbs[0], limbs.size());
+    report("crowd two bone", name, 2, n * CROWD_SIZE, now() - start);
+
+    // The vertex stream for drawing the whole crowd in one call
+    BoneBatch batch;
+    for (int markers = 0; markers < 2; markers++)
+    {
+        start = now();
+        for (size_t i = 0; i < n; i++)
+        {
+            batch.clear();
+            for (size_t j = 0; j < crowd.size(); j++)
+                batch.add(crowd.getPalette(j), crowd.getPose(j), numBones, markers != 0);
+            sink = sink + batch.data()[batch.size() - 1].pos.x;
+        }
+        report(markers ? "bone stream markers" : "bone stream", name, numBones,
+                n * CROWD_SIZE, now() - start);
+    }
+}
+
+// Chains are timed per bone of the chain rather than of the rig
+static void benchIK(const char *name, const Rig &rig, int root, int effector)
+{
+    const size_t numBones = rig.numBones();
+    const std::vector<BoneFrame> &refPose = rig.getRefPose();
+    std::vector<glm::mat4> refPalette(numBones);
+    rig.computePalette(&refPose[0], glm::mat4(1.f), &refPalette[0]);
+
+    size_t chainLength = 1;
+    for (int bone = effector; bone != root; bone = rig.getParent(bone))
+        chainLength++;
+
+    // A reachable target, the effector's base pulled in towards the root
+    const glm::vec3 target = glm::mix(glm::vec3(refPalette[root][3]),
+            glm::vec3(refPalette[effector][3]), 0.7f) + glm::vec3(0.f, 0.f, 0.05f);
+    IKParams params;
+    params.tolerance = 1e-4f;
+
+    // Each solve starts from the reference pose, only the solved subtree
+    // needs putting back
+    std::vector<BoneFrame> pose = refPose;
+    std::vector<glm::mat4> palette = refPalette;
+    const int end = rig.getSubtreeEnd(root);
+    const size_t n = iterations(chainLength * 20);
+    for (int s = 0; s < 2; s++)
+    {
+        const double start = now();
+        for (size_t i = 0; i < n; i++)
+        {
+            std::copy(&refPose[root], &refPose[0] + end, &pose[root]);
+            std::copy(&refPalette[root], &refPalette[0] + end, &palette[root]);
+            sink = sink + (s == 0 ?
+                solveCCD(rig, &pose[0], &palette[0], root, effector, target, params) :
+                solveFABRIK(rig, &pose[0], &palette[0], root, effector, target, params));
+        }
+        report(s == 0 ? "solveCCD" : "solveFABRIK", name, chainLength, n, now() - start);
+    }
+
+    // Two bone limbs across a crowd's worth of poses.  The solve is closed
+    // form, so solving from the last result costs the same as from the
+    // reference.
+    std::vector<BoneFrame> poses(CROWD_SIZE * numBones);
+    std::vector<glm::mat4> palettes(CROWD_SIZE * numBones);
+    for (size_t c = 0; c < CROWD_SIZE; c++)
+    {
+        std::copy(refPose.begin(), refPose.end(), poses.begin() + c * numBones);
+        std::copy(refPalette.begin(), refPalette.end(), palettes.begin() + c * numBones);
+    }
+    const glm::vec3 pole = glm::vec3(refPalette[effector][3]) + glm::vec3(0.f, 0.f, 1.f);
+    const size_t batches = iterations(2 * CROWD_SIZE * 10);
+
+    double start = now();
+    for (size_t i = 0; i < batches; i++)
+    {
+        for (size_t c = 0; c < CROWD_SIZE; c++)
+            sink = sink + solveTwoBone(rig, &poses[c * numBones], &palettes[c * numBones],
+                    effector, target, pole);
+    }
+    report("solveTwoBone", name, 2, batches * CROWD_SIZE, now() - start);
+
+    TwoBoneBatch batch;
+    start = now();
+    for (size_t i = 0; i < batches; i++)
+    {
+        batch.clear();
+        for (size_t c = 0; c < CROWD_SIZE; c++)
+            batch.add(rig, &poses[c * numBones], &palettes[c * numBones], effector, target, pole);
+        batch.solve();
+        sink = sink + palettes[numBones - 1][3].x;
+    }
+    report("TwoBoneBatch", name, 2, batches * CROWD_SIZE, now() - start);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 3 && strcmp(argv[1], "-scale") == 0)
+        scale = atof(argv[2]);
+    else if (argc != 1)
+    {
+        std::cerr << "usage: " << argv[0] << " [-scale s]\n";
+        exit(1);
+    }
+    srand(1);
+
+    JobSystem jobs;
+    std::cout << "Crowds of " << CROWD_SIZE << " on " << jobs.numThreads() << " threads\n";
+
+    // The test rig drives its own clip, the generated ones a random clip
+    struct BenchRig { const char *name; int segments; int limbLength; };
+    const BenchRig rigs[] = { { "small", 0, 0 }, { "medium", 4, 7 }, { "large", 16, 15 } };
+
+    for (size_t r = 0; r < sizeof(rigs) / sizeof(rigs[0]); r++)
+    {
+        const char *name = rigs[r].name;
+        std::string bonesFile = "test.bones", animFile = "testanim.anim";
+        char tmpBones[] = "/tmp/benchbonesXXXXXX";
+        char tmpAnim[] = "/tmp/benchanimXXXXXX";
+        if (rigs[r].segments)
+        {
+            close(mkstemp(tmpBones));
+            close(mkstemp(tmpAnim));
+            bonesFile = tmpBones;
+            animFile = tmpAnim;
+            writeTestRig(bonesFile, rigs[r].segments, rigs[r].limbLength);
+        }
+
+        Rig rig;
+        if (!rig.readRig(bonesFile))
+            exit(1);
+        if (rigs[r].segments)
+            writeTestAnim(animFile, rig);
+        const Animation anim = readAnimation(animFile, rig);
+
+        std::cout << '\n';
+        benchLoading(name, bonesFile, animFile);
+        benchLookup(name, anim);
+        benchSampling(name, rig, anim);
+        benchBlending(name, rig, anim);
+        benchPalette(name, rig, anim);
+        benchCrowd(name, rig, anim, jobs);
+
+        // The longest limb, from the first bone below the spine to its end
+        if (rigs[r].segments)
+        {
+            std::stringstream root, effector;
+            root << "spine" << rigs[r].segments - 1 << "_r0";
+            effector << "spine" << rigs[r].segments - 1 << "_r" << rigs[r].limbLength - 1;
+            benchIK(name, rig, rig.getBoneIndex(root.str()), rig.getBoneIndex(effector.str()));
+        }
+        else
+            benchIK(name, rig, rig.getBoneIndex("backh"), rig.getBoneIndex("rarml"));
+
+        if (rigs[r].segments)
+        {
+            unlink(tmpBones);
+            unlink(tmpAnim);
+        }
+    }
+    return 0;
+}
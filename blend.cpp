@@ -0,0 +1,103 @@
+#include "blend.h"
+#include <cassert>
+
+void blendPoses(const BoneFrame *a, const BoneFrame *b, size_t numBones,
+        float weight, const float *mask, BoneFrame *out)
+{
+    for (size_t i = 0; i < numBones; i++)
+    {
+        const float w = mask ? weight * mask[i] : weight;
+        // Separate clips can land in opposite hemispheres
+        const float sign = glm::dot(a[i].rot, b[i].rot) < 0.f ? -1.f : 1.f;
+
+        out[i].length = (1 - w) * a[i].length + w * b[i].length;
+        out[i].rot = glm::normalize(a[i].rot * (1 - w) + b[i].rot * (w * sign));
+    }
+}
+
+void makeAdditive(Animation &anim, const BoneFrame *ref)
+{
+    assert(!anim.additive);
+
+    for (size_t k = 0; k < anim.keyframes.size(); k++)
+    {
+        std::vector<BoneFrame> &bones = anim.keyframes[k].bones;
+        for (size_t i = 0; i < bones.size(); i++)
+        {
+            bones[i].rot = glm::normalize(glm::conjugate(ref[i].rot) * bones[i].rot);
+            bones[i].length -= ref[i].length;
+        }
+    }
+    anim.additive = true;
+}
+
+void makeAdditive(Animation &anim, const Rig &rig)
+{
+    makeAdditive(anim, &rig.getRefPose()[0]);
+}
+
+void makeAdditive(Animation &anim, float refFrame)
+{
+    assert(!anim.keyframes.empty());
+
+    // Sampled up front, the keys it comes from are about to change
+    std::vector<BoneFrame> ref(anim.keyframes.front().bones.size());
+    samplePose(anim, refFrame, &ref[0]);
+    makeAdditive(anim, &ref[0]);
+}
+
+void applyAdditive(const BoneFrame *base, const BoneFrame *delta, size_t numBones,
+        float weight, const float *mask, BoneFrame *out)
+{
+    for (size_t i = 0; i < numBones; i++)
+    {
+        const float w = mask ? weight * mask[i] : weight;
+
+        // Scale the delta rotation towards identity, full weight skips it
+        glm::quat rot = delta[i].rot;
+        if (w != 1.f)
+        {
+            const float sign = rot.w < 0.f ? -1.f : 1.f;
+            rot = glm::normalize(glm::quat(1.f - w + w * sign * rot.w,
+                        w * sign * rot.x, w * sign * rot.y, w * sign * rot.z));
+        }
+
+        out[i].rot = base[i].rot * rot;
+        out[i].length = base[i].length + w * delta[i].length;
+    }
+}
+
+void buildSubtreeMask(const Rig &rig, int bone, float value, float *mask)
+{
+    const int end = rig.getSubtreeEnd(bone);
+    for (int i = 0; i < static_cast<int>(rig.numBones()); i++)
+        mask[i] = (i >= bone && i < end) ? value : 0.f;
+}
+
+PoseBlender::PoseBlender(size_t numBones) :
+    scratch_(numBones)
+{
+}
+
+void PoseBlender::blend(const Animation &a, float frameA, AnimCursor *cursorA,
+        const Animation &b, float frameB, AnimCursor *cursorB,
+        float weight, const float *mask, BoneFrame *out)
+{
+    assert(a.keyframes.front().bones.size() == scratch_.size());
+    assert(b.keyframes.front().bones.size() == scratch_.size());
+
+    samplePose(a, frameA, out, cursorA);
+    samplePose(b, frameB, &scratch_[0], cursorB);
+    blendPoses(out, &scratch_[0], scratch_.size(), weight, mask, out);
+}
+
+void PoseBlender::blend(const PoseSampler &a, float frameA, AnimCursor *cursorA,
+        const PoseSampler &b, float frameB, AnimCursor *cursorB,
+        float weight, const float *mask, BoneFrame *out)
+{
+    assert(a.numBones() == scratch_.size() && b.numBones() == scratch_.size());
+
+    a.samplePose(frameA, out, cursorA);
+    b.samplePose(frameB, &scratch_[0], cursorB);
+    blendPoses(out, &scratch_[0], scratch_.size(), weight, mask, out);
+}
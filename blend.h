@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include "rig.h"
+#include "animation.h"
+#include "sampler.h"
+
+// Blends poses a and b bone by bone into out, which may alias either.
+// weight 0 gives a and 1 gives b; mask, if not NULL, holds a weight per
+// bone that scales weight, so bones masked to 0 stay on a.
+void blendPoses(const BoneFrame *a, const BoneFrame *b, size_t numBones,
+        float weight, const float *mask, BoneFrame *out);
+
+// Fills mask for every bone of rig, value for bone's subtree and 0 for
+// everything else, e.g. an upper body mask from the spine
+void buildSubtreeMask(const Rig &rig, int bone, float value, float *mask);
+
+// Turns anim into an additive clip in place, each key becoming its delta
+// from ref: rotation conjugate(ref) * key and length key - ref.  Done once
+// at import so applying a layer is a multiply per bone.
+void makeAdditive(Animation &anim, const BoneFrame *ref);
+// Deltas against the rig's reference pose
+void makeAdditive(Animation &anim, const Rig &rig);
+// Deltas against anim's own pose at refFrame
+void makeAdditive(Animation &anim, float refFrame);
+
+// Applies a sampled additive pose on top of base into out, which may alias
+// base.  weight and mask scale the delta the same way as blendPoses.
+void applyAdditive(const BoneFrame *base, const BoneFrame *delta, size_t numBones,
+        float weight, const float *mask, BoneFrame *out);
+
+// Samples two clips and blends them, a straight into out and b into a
+// scratch pose that is allocated once, so blending never touches the heap.
+class PoseBlender
+{
+public:
+    explicit PoseBlender(size_t numBones);
+
+    size_t numBones() const { return scratch_.size(); }
+
+    void blend(const Animation &a, float frameA, AnimCursor *cursorA,
+            const Animation &b, float frameB, AnimCursor *cursorB,
+            float weight, const float *mask, BoneFrame *out);
+    void blend(const PoseSampler &a, float frameA, AnimCursor *cursorA,
+            const PoseSampler &b, float frameB, AnimCursor *cursorB,
+            float weight, const float *mask, BoneFrame *out);
+
+private:
+    std::vector<BoneFrame> scratch_;
+};
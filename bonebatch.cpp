@@ -0,0 +1,68 @@
+#include "bonebatch.h"
+
+const int BoneBatch::LINE_VERTICES   = 2;
+const int BoneBatch::MARKER_VERTICES = 24;
+
+static const glm::vec3 BASE_COLOR(0.f, 1.f, 0.f);
+static const glm::vec3 TIP_COLOR(1.f, 0.f, 0.f);
+static const glm::vec3 MARKER_COLOR(0.5f, 0.5f, 0.5f);
+static const glm::vec3 SELECTED_COLOR(0.2f, 0.2f, 0.8f);
+
+// Corner i of a cube has x, y and z set by bits 0, 1 and 2
+static const int CUBE_EDGES[12][2] = {
+    {0, 1}, {2, 3}, {4, 5}, {6, 7},
+    {0, 2}, {1, 3}, {4, 6}, {5, 7},
+    {0, 4}, {1, 5}, {2, 6}, {3, 7}};
+
+void BoneBatch::add(const glm::mat4 *palette, const BoneFrame *pose, size_t numBones,
+        bool markers, int selected)
+{
+    if (numBones < 2)
+        return;
+
+    size_t perBone = LINE_VERTICES + (markers ? MARKER_VERTICES : 0);
+    size_t start = size_;
+    size_ += (numBones - 1) * perBone;
+    if (vertices_.size() < size_)
+        vertices_.resize(size_);
+    BoneVertex *out = &vertices_[start];
+
+    for (size_t i = 1; i < numBones; i++)
+    {
+        const glm::mat4 &m = palette[i];
+        float length = pose[i].length;
+        glm::vec3 tip = glm::vec3(m[3]) + glm::vec3(m[0]) * length;
+
+        out[0].pos = glm::vec3(m[3]);
+        out[0].color = BASE_COLOR;
+        out[1].pos = tip;
+        out[1].color = TIP_COLOR;
+        out += LINE_VERTICES;
+
+        if (!markers)
+            continue;
+
+        // The old tip cube spanned +-1 scaled by a tenth of the length
+        float half = length / 10.f;
+        glm::vec3 x = glm::vec3(m[0]) * half;
+        glm::vec3 y = glm::vec3(m[1]) * half;
+        glm::vec3 z = glm::vec3(m[2]) * half;
+        glm::vec3 corners[8];
+        corners[0] = tip - x - y - z;
+        corners[1] = corners[0] + 2.f * x;
+        corners[2] = corners[0] + 2.f * y;
+        corners[3] = corners[1] + 2.f * y;
+        for (int c = 0; c < 4; c++)
+            corners[c + 4] = corners[c] + 2.f * z;
+
+        const glm::vec3 &color = int(i) == selected ? SELECTED_COLOR : MARKER_COLOR;
+        for (int e = 0; e < 12; e++)
+        {
+            out[2 * e].pos = corners[CUBE_EDGES[e][0]];
+            out[2 * e].color = color;
+            out[2 * e + 1].pos = corners[CUBE_EDGES[e][1]];
+            out[2 * e + 1].color = color;
+        }
+        out += MARKER_VERTICES;
+    }
+}
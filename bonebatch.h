@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "rig.h"
+
+// Interleaved vertex layout of a BoneBatch stream
+struct BoneVertex
+{
+    glm::vec3 pos;
+    glm::vec3 color;
+};
+
+// Line list for any number of skeletons, built on the CPU from their
+// palettes so it can be drawn with a single call.  Each bone is a line
+// from its base, in green, to its tip, in red.  Tip markers are wire cubes
+// aligned with the bone, reaching a tenth of its length either side of
+// the tip.
+// Storage is kept between frames, so once the stream has grown to the
+// largest frame, clearing and adding never allocate.  No GL is used here.
+class BoneBatch
+{
+public:
+    // Vertices added per bone
+    static const int LINE_VERTICES;
+    static const int MARKER_VERTICES;
+
+    BoneBatch() : size_(0) {}
+
+    void clear() { size_ = 0; }
+
+    // Appends bones [1, numBones) of one skeleton, bone 0 the root is never
+    // drawn.  The palette is in the space the stream is drawn in.  Tip
+    // markers are added when markers is set, highlighted for the selected
+    // bone, -1 for none.
+    void add(const glm::mat4 *palette, const BoneFrame *pose, size_t numBones,
+            bool markers = false, int selected = -1);
+
+    size_t size() const { return size_; }
+    const BoneVertex *data() const { return size_ ? &vertices_[0] : NULL; }
+
+private:
+    // Only grows, so vertices past size_ aren't initialized again each frame
+    std::vector<BoneVertex> vertices_;
+    size_t size_;
+};
@@ -0,0 +1,20 @@
+// Converts a .bones text rig to the binary rig format read by Rig::readRig
+#include <iostream>
+#include <cstdlib>
+#include "rig.h"
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        std::cerr << "usage: " << argv[0] << " in.bones out.rig\n";
+        exit(1);
+    }
+
+    Rig rig;
+    if (!rig.readRig(argv[1]) || !rig.writeRig(argv[2]))
+        exit(1);
+
+    std::cout << "Wrote " << rig.numBones() << " bones to " << argv[2] << '\n';
+    return 0;
+}
@@ -0,0 +1,387 @@
+#include "clipfile.h"
+#include <iostream>
+#include <fstream>
+#include <cassert>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Binary clip format, native endian, every field 4 byte aligned:
+//   ClipFileHeader
+//   int32          keyFrames[numKeys]     frame number of each key
+//   ClipTrackEntry tracks[numTracks]      table of contents
+//   char           strings[stringTableSize] clip and bone names
+//   float          track data, numKeys * FLOATS_PER_KEY per track
+// A key is length, x,y,z,w.  Every track has a key for every keyframe.
+static const char CLIP_MAGIC[4] = { 'K', 'S', 'C', 'L' };
+static const char CLIP_EXTENSION[] = ".clip";
+static const uint32_t CLIP_VERSION = 1;
+static const size_t FLOATS_PER_KEY = 5;
+
+struct ClipFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t numTracks;
+    uint32_t numKeys;
+    int32_t numFrames;
+    uint32_t nameOffset;
+    uint32_t stringTableSize;
+    uint32_t flags;
+};
+
+enum ClipFlags
+{
+    CLIP_ADDITIVE = 1
+};
+
+struct ClipTrackEntry
+{
+    uint32_t nameOffset;
+    // from the start of the file
+    uint32_t dataOffset;
+};
+
+static const ClipFileHeader *getHeader(const char *data)
+{
+    return reinterpret_cast<const ClipFileHeader *>(data);
+}
+
+static uint64_t tocOffset(const ClipFileHeader *header)
+{
+    return sizeof(ClipFileHeader) + uint64_t(header->numKeys) * sizeof(int32_t);
+}
+
+static uint64_t stringTableOffset(const ClipFileHeader *header)
+{
+    return tocOffset(header) + uint64_t(header->numTracks) * sizeof(ClipTrackEntry);
+}
+
+static uint64_t trackBytes(const ClipFileHeader *header)
+{
+    return uint64_t(header->numKeys) * FLOATS_PER_KEY * sizeof(float);
+}
+
+// True if a NUL terminated string starts at offset inside the string table
+static bool validString(const ClipFileHeader *header, const char *strings, uint32_t offset)
+{
+    return offset < header->stringTableSize &&
+        memchr(strings + offset, '\0', header->stringTableSize - offset) != NULL;
+}
+
+// Checks every offset in the header and table of contents against the
+// file size, so nothing read later can land outside the mapping
+static bool validClip(const char *data, size_t size)
+{
+    const ClipFileHeader *header = getHeader(data);
+    // Sampling needs at least one key
+    if (memcmp(header->magic, CLIP_MAGIC, sizeof(CLIP_MAGIC)) != 0 ||
+            header->version != CLIP_VERSION || header->numKeys == 0)
+        return false;
+
+    // Header fields are 32 bit, so the tables can't wrap 64 bits but the
+    // track data can, check it by division instead of multiplying
+    const uint64_t tablesEnd = stringTableOffset(header) + header->stringTableSize;
+    if (size < tablesEnd || header->numTracks > (size - tablesEnd) / trackBytes(header))
+        return false;
+
+    const char *strings = data + stringTableOffset(header);
+    if (!validString(header, strings, header->nameOffset))
+        return false;
+
+    const ClipTrackEntry *toc =
+        reinterpret_cast<const ClipTrackEntry *>(data + tocOffset(header));
+    for (size_t t = 0; t < header->numTracks; t++)
+    {
+        if (!validString(header, strings, toc[t].nameOffset) ||
+                toc[t].dataOffset % sizeof(float) != 0 ||
+                toc[t].dataOffset + trackBytes(header) > size)
+            return false;
+    }
+    return true;
+}
+
+ClipFile::ClipFile() :
+    data_(NULL), size_(0), rig_(NULL)
+{
+}
+
+ClipFile::~ClipFile()
+{
+    close();
+}
+
+bool ClipFile::open(const std::string &filename)
+{
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "Unable to open clip file: " << filename << '\n';
+        return false;
+    }
+
+    struct stat st;
+    fstat(fd, &st);
+    size_t size = st.st_size;
+
+    void *data = MAP_FAILED;
+    if (size >= sizeof(ClipFileHeader))
+        data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        std::cerr << "Unable to map clip file: " << filename << '\n';
+        return false;
+    }
+
+    if (!validClip(static_cast<const char *>(data), size))
+    {
+        std::cerr << "Bad clip file: " << filename << '\n';
+        munmap(data, size);
+        return false;
+    }
+
+    // Tracks are sampled one at a time, don't read ahead the whole file
+    madvise(data, size, MADV_RANDOM);
+
+    data_ = static_cast<const char *>(data);
+    size_ = size;
+    return true;
+}
+
+void ClipFile::close()
+{
+    if (data_)
+        munmap(const_cast<char *>(data_), size_);
+    data_ = NULL;
+    size_ = 0;
+    rig_ = NULL;
+    boneTracks_.clear();
+    defaultPose_.clear();
+}
+
+void ClipFile::bind(const Rig &rig)
+{
+    assert(isOpen());
+
+    rig_ = &rig;
+    boneTracks_.assign(rig.numBones(), -1);
+
+    // An additive clip's keys are deltas, bones without a track get the
+    // identity delta rather than having their reference pose added twice
+    defaultPose_ = rig.getRefPose();
+    if (isAdditive())
+    {
+        for (size_t bone = 0; bone < defaultPose_.size(); bone++)
+        {
+            defaultPose_[bone].length = 0.f;
+            defaultPose_[bone].rot = glm::quat(1.f, 0.f, 0.f, 0.f);
+        }
+    }
+
+    for (size_t t = 0; t < numTracks(); t++)
+    {
+        int bone = rig.getBoneIndex(getTrackName(t));
+        if (bone < 0)
+        {
+            std::cerr << "Clip track '" << getTrackName(t) << "' has no bone in rig\n";
+            continue;
+        }
+        boneTracks_[bone] = t;
+    }
+}
+
+const char *ClipFile::getName() const
+{
+    const ClipFileHeader *header = getHeader(data_);
+    return data_ + stringTableOffset(header) + header->nameOffset;
+}
+
+bool ClipFile::isAdditive() const
+{
+    return (getHeader(data_)->flags & CLIP_ADDITIVE) != 0;
+}
+
+int ClipFile::numFrames() const
+{
+    return getHeader(data_)->numFrames;
+}
+
+size_t ClipFile::numKeys() const
+{
+    return getHeader(data_)->numKeys;
+}
+
+size_t ClipFile::numTracks() const
+{
+    return getHeader(data_)->numTracks;
+}
+
+const char *ClipFile::getTrackName(size_t track) const
+{
+    const ClipFileHeader *header = getHeader(data_);
+    const ClipTrackEntry *toc =
+        reinterpret_cast<const ClipTrackEntry *>(data_ + tocOffset(header));
+    return data_ + stringTableOffset(header) + toc[track].nameOffset;
+}
+
+const int32_t *ClipFile::getKeyFrames() const
+{
+    return reinterpret_cast<const int32_t *>(data_ + sizeof(ClipFileHeader));
+}
+
+const float *ClipFile::getTrack(size_t track) const
+{
+    const ClipFileHeader *header = getHeader(data_);
+    const ClipTrackEntry *toc =
+        reinterpret_cast<const ClipTrackEntry *>(data_ + tocOffset(header));
+    return reinterpret_cast<const float *>(data_ + toc[track].dataOffset);
+}
+
+void ClipFile::copyKey(size_t key, BoneFrame *out) const
+{
+    for (size_t bone = 0; bone < boneTracks_.size(); bone++)
+    {
+        if (boneTracks_[bone] < 0)
+        {
+            out[bone] = defaultPose_[bone];
+            continue;
+        }
+
+        const float *k = getTrack(boneTracks_[bone]) + key * FLOATS_PER_KEY;
+        out[bone].length = k[0];
+        out[bone].rot = glm::quat(k[4], k[1], k[2], k[3]);
+    }
+}
+
+void ClipFile::samplePose(float frame, BoneFrame *out, AnimCursor *cursor) const
+{
+    assert(rig_ && numKeys() > 0);
+
+    size_t k0, k1;
+    float fact;
+    if (!selectKeys(getKeyFrames(), numKeys(), numFrames(), frame, cursor, &k0, &k1, &fact))
+    {
+        copyKey(k0, out);
+        return;
+    }
+    for (size_t bone = 0; bone < boneTracks_.size(); bone++)
+    {
+        if (boneTracks_[bone] < 0)
+        {
+            out[bone] = defaultPose_[bone];
+            continue;
+        }
+
+        const float *track = getTrack(boneTracks_[bone]);
+        const float *a = track + k0 * FLOATS_PER_KEY;
+        const float *b = track + k1 * FLOATS_PER_KEY;
+        glm::quat arot(a[4], a[1], a[2], a[3]);
+        glm::quat brot(b[4], b[1], b[2], b[3]);
+
+        out[bone].rot = glm::normalize(arot * (1 - fact) + brot * fact);
+        out[bone].length = fact * b[0] + (1 - fact) * a[0];
+    }
+}
+
+Animation ClipFile::toAnimation() const
+{
+    assert(rig_);
+
+    Animation anim;
+    anim.name = getName();
+    anim.numframes = numFrames();
+    anim.additive = isAdditive();
+    anim.keyframes.resize(numKeys());
+
+    const int32_t *keyFrames = getKeyFrames();
+    for (size_t k = 0; k < numKeys(); k++)
+    {
+        anim.keyframes[k].frame = keyFrames[k];
+        anim.keyframes[k].bones.resize(boneTracks_.size());
+        copyKey(k, &anim.keyframes[k].bones[0]);
+    }
+
+    return anim;
+}
+
+bool hasClipExtension(const std::string &filename)
+{
+    const size_t n = sizeof(CLIP_EXTENSION) - 1;
+    return filename.size() >= n &&
+        filename.compare(filename.size() - n, n, CLIP_EXTENSION) == 0;
+}
+
+bool writeClipFile(const std::string &filename, const Animation &anim, const Rig &rig)
+{
+    const uint32_t numTracks = rig.numBones();
+    const uint32_t numKeys = anim.keyframes.size();
+
+    // String table, clip name first then one name per track
+    std::string strings = anim.name;
+    strings += '\0';
+    std::vector<ClipTrackEntry> toc(numTracks);
+    for (size_t t = 0; t < numTracks; t++)
+    {
+        toc[t].nameOffset = strings.size();
+        strings += rig.getBoneName(t);
+        strings += '\0';
+    }
+    while (strings.size() % 4)
+        strings += '\0';
+
+    ClipFileHeader header;
+    memcpy(header.magic, CLIP_MAGIC, sizeof(CLIP_MAGIC));
+    header.version = CLIP_VERSION;
+    header.numTracks = numTracks;
+    header.numKeys = numKeys;
+    header.numFrames = anim.numframes;
+    header.nameOffset = 0;
+    header.stringTableSize = strings.size();
+    header.flags = anim.additive ? CLIP_ADDITIVE : 0;
+
+    const size_t trackSize = numKeys * FLOATS_PER_KEY * sizeof(float);
+    const size_t dataStart = stringTableOffset(&header) + strings.size();
+    for (size_t t = 0; t < numTracks; t++)
+        toc[t].dataOffset = dataStart + t * trackSize;
+
+    std::vector<int32_t> keyFrames(numKeys);
+    for (size_t k = 0; k < numKeys; k++)
+        keyFrames[k] = anim.keyframes[k].frame;
+
+    std::ofstream file(filename.c_str(), std::ios::binary);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(&keyFrames[0]), numKeys * sizeof(int32_t));
+    file.write(reinterpret_cast<const char *>(&toc[0]), numTracks * sizeof(ClipTrackEntry));
+    file.write(strings.data(), strings.size());
+
+    // Transpose keyframes into one contiguous track per bone
+    std::vector<float> track(numKeys * FLOATS_PER_KEY);
+    for (size_t t = 0; t < numTracks; t++)
+    {
+        for (size_t k = 0; k < numKeys; k++)
+        {
+            assert(anim.keyframes[k].bones.size() == numTracks);
+            const BoneFrame &bf = anim.keyframes[k].bones[t];
+            float *key = &track[k * FLOATS_PER_KEY];
+            key[0] = bf.length;
+            key[1] = bf.rot.x;
+            key[2] = bf.rot.y;
+            key[3] = bf.rot.z;
+            key[4] = bf.rot.w;
+        }
+        file.write(reinterpret_cast<const char *>(&track[0]), trackSize);
+    }
+
+    if (!file)
+    {
+        std::cerr << "Unable to write clip file: " << filename << '\n';
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "rig.h"
+#include "animation.h"
+
+// A binary animation clip used straight out of a read only memory mapping.
+// Opening only checks the header and offsets, the per bone tracks are contiguous float
+// arrays that the OS pages in the first time they are sampled.
+class ClipFile
+{
+public:
+    ClipFile();
+    ~ClipFile();
+
+    bool open(const std::string &filename);
+    void close();
+    bool isOpen() const { return data_ != NULL; }
+
+    // Resolves track names to rig bones, needed before sampling.  Bones
+    // without a track are sampled from the rig's reference pose, or as the
+    // identity delta in an additive clip.
+    void bind(const Rig &rig);
+
+    const char *getName() const;
+    // Keys are deltas, see makeAdditive
+    bool isAdditive() const;
+    int numFrames() const;
+    size_t numKeys() const;
+    size_t numTracks() const;
+    const char *getTrackName(size_t track) const;
+
+    // Same behaviour as samplePose on the equivalent Animation
+    void samplePose(float frame, BoneFrame *out, AnimCursor *cursor = NULL) const;
+    // Copies every key into an in memory Animation
+    Animation toAnimation() const;
+
+private:
+    const char *data_;
+    size_t size_;
+    const Rig *rig_;
+    // track index for each bone of the bound rig, -1 for none
+    std::vector<int> boneTracks_;
+    // What bones without a track are sampled as
+    std::vector<BoneFrame> defaultPose_;
+
+    const int32_t *getKeyFrames() const;
+    const float *getTrack(size_t track) const;
+    void copyKey(size_t key, BoneFrame *out) const;
+
+    // Not copyable
+    ClipFile(const ClipFile &);
+    ClipFile &operator=(const ClipFile &);
+};
+
+// True if filename ends in .clip, the extension binary clips are loaded by
+bool hasClipExtension(const std::string &filename);
+
+// Writes anim, whose keyframes are in rig's bone order, as a binary clip
+bool writeClipFile(const std::string &filename, const Animation &anim, const Rig &rig);
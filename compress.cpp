@@ -0,0 +1,445 @@
+#include "compress.h"
+#include "blend.h"
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+static const float SQRT1_2 = 0.70710678f;
+static const int MIN_ROT_BITS = 4;
+static const int MAX_BITS = 16;
+// Budgets are halved on every attempt that fails the final error check
+static const int MAX_ATTEMPTS = 8;
+
+// Quantized smallest three rotation, the largest component is dropped and
+// rebuilt from the unit length constraint.  negative keeps the key's sign:
+// q and -q are the same rotation, but nlerp between two keys takes the
+// long way round when they are in opposite hemispheres, so decoded keys
+// must keep the source's signs to interpolate the same way.
+struct PackedRot
+{
+    uint32_t largest;
+    uint32_t negative;
+    uint32_t comps[3];
+};
+
+// Index, sign and three components
+static uint32_t rotKeyBits(int bits)
+{
+    return 3 + 3 * bits;
+}
+
+static void writeBits(std::vector<uint32_t> &bits, uint32_t &pos, uint32_t value, int n)
+{
+    for (int i = 0; i < n; i++, pos++)
+    {
+        if (pos / 32 >= bits.size())
+            bits.push_back(0);
+        if (value & (1u << i))
+            bits[pos / 32] |= 1u << (pos % 32);
+    }
+}
+
+static uint32_t readBits(const uint32_t *bits, uint32_t pos, int n)
+{
+    // n is at most 16, so the value spans at most two words
+    const uint32_t shift = pos % 32;
+    uint64_t window = bits[pos / 32];
+    if (shift + n > 32)
+        window |= static_cast<uint64_t>(bits[pos / 32 + 1]) << 32;
+    return (window >> shift) & ((1u << n) - 1);
+}
+
+static PackedRot packRot(const glm::quat &q, int bits)
+{
+    const float c[4] = { q.x, q.y, q.z, q.w };
+    int largest = 0;
+    for (int i = 1; i < 4; i++)
+        if (fabsf(c[i]) > fabsf(c[largest]))
+            largest = i;
+
+    // Quantize with the dropped component positive, the sign is restored
+    // on unpacking
+    const float sign = c[largest] < 0.f ? -1.f : 1.f;
+    const float maxq = (1u << bits) - 1;
+
+    PackedRot packed;
+    packed.largest = largest;
+    packed.negative = sign < 0.f;
+    for (int i = 0, j = 0; i < 4; i++)
+    {
+        if (i == largest)
+            continue;
+        float v = glm::clamp(c[i] * sign, -SQRT1_2, SQRT1_2);
+        packed.comps[j++] = static_cast<uint32_t>((v + SQRT1_2) / (2.f * SQRT1_2) * maxq + 0.5f);
+    }
+
+    return packed;
+}
+
+static glm::quat unpackRot(const PackedRot &packed, int bits)
+{
+    const float maxq = (1u << bits) - 1;
+
+    float c[4];
+    float sum = 0.f;
+    for (int i = 0, j = 0; i < 4; i++)
+    {
+        if (i == static_cast<int>(packed.largest))
+            continue;
+        c[i] = packed.comps[j++] / maxq * (2.f * SQRT1_2) - SQRT1_2;
+        sum += c[i] * c[i];
+    }
+    c[packed.largest] = sqrtf(std::max(0.f, 1.f - sum));
+
+    glm::quat q = glm::normalize(glm::quat(c[3], c[0], c[1], c[2]));
+    return packed.negative ? -q : q;
+}
+
+// Rotation angle between two unit quaternions, in radians
+static float rotError(const glm::quat &a, const glm::quat &b)
+{
+    // atan2 of the relative rotation keeps precision for tiny angles, where
+    // acos of the dot product rounds to zero
+    glm::quat d = glm::conjugate(a) * b;
+    float s = sqrtf(d.x * d.x + d.y * d.y + d.z * d.z);
+    return 2.f * atan2f(s, fabsf(d.w));
+}
+
+static uint32_t packLength(float length, float lmin, float range, int bits)
+{
+    const float maxq = (1u << bits) - 1;
+    return static_cast<uint32_t>((length - lmin) / range * maxq + 0.5f);
+}
+
+static float unpackLength(uint32_t q, float lmin, float range, int bits)
+{
+    const float maxq = (1u << bits) - 1;
+    return lmin + q * range / maxq;
+}
+
+CompressedClip::CompressedClip() :
+    rig_(NULL), numframes_(0), additive_(false), measuredError_(0.f)
+{
+}
+
+bool CompressedClip::compress(const Animation &anim, const Rig &rig, float maxError)
+{
+    assert(!anim.keyframes.empty());
+
+    const size_t numBones = rig.numBones();
+    rig_ = &rig;
+    numframes_ = anim.numframes;
+    additive_ = anim.additive;
+    defaultPose_ = rig.getRefPose();
+    if (additive_)
+    {
+        for (size_t b = 0; b < numBones; b++)
+        {
+            defaultPose_[b].rot = glm::quat(1.f, 0.f, 0.f, 0.f);
+            defaultPose_[b].length = 0.f;
+        }
+    }
+    keyFrames_.resize(anim.keyframes.size());
+    for (size_t k = 0; k < anim.keyframes.size(); k++)
+        keyFrames_[k] = anim.keyframes[k].frame;
+
+    // Longest length each bone reaches anywhere in the clip, additive
+    // lengths are added to the reference pose's
+    std::vector<float> maxLength(numBones, 0.f);
+    for (size_t k = 0; k < anim.keyframes.size(); k++)
+        for (size_t b = 0; b < numBones; b++)
+        {
+            float length = anim.keyframes[k].bones[b].length;
+            if (additive_)
+                length += rig.getRefPose()[b].length;
+            maxLength[b] = std::max(maxLength[b], fabsf(length));
+        }
+
+    // reach is the furthest any descendant tip gets from the bone's base,
+    // depth the number of bones from the root.  Children always come after
+    // their parent, so walk backwards for reach and forwards for depth.
+    std::vector<BoneFrame> zeroLength(rig.getRefPose());
+    for (size_t b = 0; b < numBones; b++)
+        zeroLength[b].length = 0.f;
+
+    std::vector<float> reach(maxLength);
+    for (size_t b = numBones; b > 1; b--)
+    {
+        int child = b - 1;
+        int parent = rig.getParent(child);
+        // offset of the child from the parent's tip
+        float offset = glm::length(rig.getBoneOffset(&zeroLength[0], child));
+        reach[parent] = std::max(reach[parent], maxLength[parent] + offset + reach[child]);
+    }
+
+    std::vector<int> depth(numBones, 1);
+    int maxDepth = 1;
+    for (size_t b = 1; b < numBones; b++)
+    {
+        depth[b] = depth[rig.getParent(b)] + 1;
+        maxDepth = std::max(maxDepth, depth[b]);
+    }
+
+    // Error at a bone is at most the sum, over the bone and its ancestors,
+    // of rotation error times reach plus length error.  Give every track
+    // the same share of positional error.
+    const float share = maxError / (2.f * maxDepth);
+    std::vector<float> rotBudget(numBones), lengthBudget(numBones, share);
+    for (size_t b = 0; b < numBones; b++)
+        rotBudget[b] = share / std::max(reach[b], 1e-6f);
+
+    // The bound holds at the keys by construction, the measurement confirms
+    // it and catches interpolation between keys drifting past it
+    for (int attempt = 0; attempt < MAX_ATTEMPTS; attempt++)
+    {
+        build(anim, rotBudget, lengthBudget, attempt);
+        measuredError_ = measureError(anim);
+        if (measuredError_ <= maxError)
+            return true;
+    }
+    return false;
+}
+
+void CompressedClip::build(const Animation &anim, const std::vector<float> &rotBudget,
+        const std::vector<float> &lengthBudget, int attempt)
+{
+    const size_t numBones = rig_->numBones();
+    const size_t numKeys = anim.keyframes.size();
+    const float scale = 1.f / (1 << attempt);
+
+    tracks_.resize(numBones);
+    bits_.clear();
+    uint32_t pos = 0;
+
+    for (size_t b = 0; b < numBones; b++)
+    {
+        Track &track = tracks_[b];
+        const float rbudget = rotBudget[b] * scale;
+        const float lbudget = lengthBudget[b] * scale;
+        const BoneFrame &first = anim.keyframes[0].bones[b];
+
+        track.flags = 0;
+        track.rotBits = 0;
+        track.lengthBits = 0;
+        track.constRot = first.rot;
+        track.lengthMin = first.length;
+        track.lengthRange = 0.f;
+
+        float staticRot = 0.f, constRot = 0.f;
+        float staticLength = 0.f;
+        float lmin = first.length, lmax = first.length;
+        for (size_t k = 0; k < numKeys; k++)
+        {
+            const BoneFrame &bf = anim.keyframes[k].bones[b];
+            staticRot = std::max(staticRot, rotError(bf.rot, defaultPose_[b].rot));
+            constRot = std::max(constRot, rotError(bf.rot, first.rot));
+            staticLength = std::max(staticLength, fabsf(bf.length - defaultPose_[b].length));
+            lmin = std::min(lmin, bf.length);
+            lmax = std::max(lmax, bf.length);
+        }
+
+        if (staticRot <= rbudget)
+            track.flags |= STATIC_ROT;
+        else if (constRot <= rbudget)
+            track.flags |= CONSTANT_ROT;
+        else
+        {
+            // Fewest bits that keep every key inside the budget
+            int bits;
+            for (bits = MIN_ROT_BITS; bits < MAX_BITS; bits++)
+            {
+                float err = 0.f;
+                for (size_t k = 0; k < numKeys && err <= rbudget; k++)
+                {
+                    const glm::quat &q = anim.keyframes[k].bones[b].rot;
+                    err = std::max(err, rotError(q, unpackRot(packRot(q, bits), bits)));
+                }
+                if (err <= rbudget)
+                    break;
+            }
+            track.rotBits = bits;
+        }
+
+        if (staticLength <= lbudget)
+            track.flags |= STATIC_LENGTH;
+        else if (lmax - lmin <= lbudget)
+            track.flags |= CONSTANT_LENGTH;
+        else
+        {
+            // Rounding error is half a step
+            const float range = lmax - lmin;
+            int bits;
+            for (bits = 1; bits < MAX_BITS; bits++)
+                if (range / ((1u << bits) - 1) / 2.f <= lbudget)
+                    break;
+            track.lengthBits = bits;
+            track.lengthMin = lmin;
+            track.lengthRange = range;
+        }
+
+        track.rotOffset = pos;
+        if (track.rotBits)
+        {
+            for (size_t k = 0; k < numKeys; k++)
+            {
+                PackedRot packed = packRot(anim.keyframes[k].bones[b].rot, track.rotBits);
+                writeBits(bits_, pos, packed.largest, 2);
+                writeBits(bits_, pos, packed.negative, 1);
+                for (int c = 0; c < 3; c++)
+                    writeBits(bits_, pos, packed.comps[c], track.rotBits);
+            }
+        }
+
+        track.lengthOffset = pos;
+        if (track.lengthBits)
+        {
+            for (size_t k = 0; k < numKeys; k++)
+                writeBits(bits_, pos, packLength(anim.keyframes[k].bones[b].length,
+                            track.lengthMin, track.lengthRange, track.lengthBits),
+                        track.lengthBits);
+        }
+    }
+
+    // Padding so reads never run off the end
+    bits_.push_back(0);
+}
+
+// Largest model space distance between the bone bases and tips of two poses
+static float poseError(const Rig &rig, const BoneFrame *pose, const BoneFrame *decoded,
+        glm::mat4 *expected, glm::mat4 *actual)
+{
+    rig.computePalette(pose, glm::mat4(1.f), expected);
+    rig.computePalette(decoded, glm::mat4(1.f), actual);
+
+    float maxErr = 0.f;
+    for (size_t b = 0; b < rig.numBones(); b++)
+    {
+        glm::vec4 ebase = expected[b][3], abase = actual[b][3];
+        glm::vec4 etip = expected[b] * glm::vec4(pose[b].length, 0.f, 0.f, 1.f);
+        glm::vec4 atip = actual[b] * glm::vec4(decoded[b].length, 0.f, 0.f, 1.f);
+        maxErr = std::max(maxErr, glm::length(glm::vec3(ebase - abase)));
+        maxErr = std::max(maxErr, glm::length(glm::vec3(etip - atip)));
+    }
+    return maxErr;
+}
+
+// Additive deltas are measured as they'll be seen, on the reference pose
+void CompressedClip::applyToRefPose(BoneFrame *pose) const
+{
+    if (additive_)
+        applyAdditive(&rig_->getRefPose()[0], pose, rig_->numBones(), 1.f, NULL, pose);
+}
+
+float CompressedClip::measureError(const Animation &anim) const
+{
+    const size_t numBones = rig_->numBones();
+    std::vector<BoneFrame> pose(numBones), decoded(numBones);
+    std::vector<glm::mat4> expected(numBones), actual(numBones);
+
+    float maxErr = 0.f;
+    for (size_t k = 0; k < anim.keyframes.size(); k++)
+    {
+        pose = anim.keyframes[k].bones;
+        decodeKey(k, &decoded[0]);
+        applyToRefPose(&pose[0]);
+        applyToRefPose(&decoded[0]);
+        maxErr = std::max(maxErr, poseError(*rig_, &pose[0], &decoded[0],
+                    &expected[0], &actual[0]));
+
+        // Half way to the next key, where interpolation strays furthest
+        if (k == 0)
+            continue;
+        float frame = 0.5f * (anim.keyframes[k - 1].frame + anim.keyframes[k].frame);
+        ::samplePose(anim, frame, &pose[0]);
+        samplePose(frame, &decoded[0]);
+        applyToRefPose(&pose[0]);
+        applyToRefPose(&decoded[0]);
+        maxErr = std::max(maxErr, poseError(*rig_, &pose[0], &decoded[0],
+                    &expected[0], &actual[0]));
+    }
+
+    return maxErr;
+}
+
+glm::quat CompressedClip::decodeRot(const Track &track, size_t key) const
+{
+    if (track.flags & CONSTANT_ROT)
+        return track.constRot;
+
+    uint32_t pos = track.rotOffset + key * rotKeyBits(track.rotBits);
+
+    PackedRot packed;
+    packed.largest = readBits(&bits_[0], pos, 2);
+    packed.negative = readBits(&bits_[0], pos + 2, 1);
+    pos += 3;
+    for (int c = 0; c < 3; c++, pos += track.rotBits)
+        packed.comps[c] = readBits(&bits_[0], pos, track.rotBits);
+
+    return unpackRot(packed, track.rotBits);
+}
+
+float CompressedClip::decodeLength(const Track &track, size_t key) const
+{
+    if (track.flags & CONSTANT_LENGTH)
+        return track.lengthMin;
+
+    uint32_t q = readBits(&bits_[0], track.lengthOffset + key * track.lengthBits,
+            track.lengthBits);
+    return unpackLength(q, track.lengthMin, track.lengthRange, track.lengthBits);
+}
+
+void CompressedClip::decodeKey(size_t key, BoneFrame *out) const
+{
+    for (size_t b = 0; b < tracks_.size(); b++)
+    {
+        const Track &track = tracks_[b];
+        out[b].rot = (track.flags & STATIC_ROT) ? defaultPose_[b].rot : decodeRot(track, key);
+        out[b].length = (track.flags & STATIC_LENGTH) ?
+            defaultPose_[b].length : decodeLength(track, key);
+    }
+}
+
+void CompressedClip::samplePose(float frame, BoneFrame *out, AnimCursor *cursor) const
+{
+    assert(rig_ && !keyFrames_.empty());
+
+    size_t k0, k1;
+    float fact;
+    if (!selectKeys(&keyFrames_[0], keyFrames_.size(), numframes_, frame, cursor,
+                &k0, &k1, &fact))
+    {
+        decodeKey(k0, out);
+        return;
+    }
+
+    for (size_t b = 0; b < tracks_.size(); b++)
+    {
+        const Track &track = tracks_[b];
+
+        if (track.flags & (STATIC_ROT | CONSTANT_ROT))
+            out[b].rot = (track.flags & STATIC_ROT) ? defaultPose_[b].rot : track.constRot;
+        else
+        {
+            glm::quat a = decodeRot(track, k0);
+            glm::quat c = decodeRot(track, k1);
+            out[b].rot = glm::normalize(a * (1 - fact) + c * fact);
+        }
+
+        if (track.flags & (STATIC_LENGTH | CONSTANT_LENGTH))
+            out[b].length = (track.flags & STATIC_LENGTH) ?
+                defaultPose_[b].length : track.lengthMin;
+        else
+        {
+            float a = decodeLength(track, k0);
+            float c = decodeLength(track, k1);
+            out[b].length = fact * c + (1 - fact) * a;
+        }
+    }
+}
+
+size_t CompressedClip::sizeInBytes() const
+{
+    return sizeof(*this) + keyFrames_.size() * sizeof(int) +
+        defaultPose_.size() * sizeof(BoneFrame) +
+        tracks_.size() * sizeof(Track) + bits_.size() * sizeof(uint32_t);
+}
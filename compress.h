@@ -0,0 +1,72 @@
+#pragma once
+#include <vector>
+#include <stdint.h>
+#include "rig.h"
+#include "animation.h"
+
+// A quantized copy of an Animation that is sampled without decompressing.
+//
+// Tracks that never move from the rig's reference pose, or from the identity
+// delta in an additive clip, are static and store nothing, tracks that hold
+// one value store it once.  Remaining rotations
+// are stored smallest three (2 bit index plus three components) and lengths
+// as a fraction of their range, each track with the fewest bits that keep
+// it inside its share of the error budget.  The shares are sized so the
+// model space position of every bone base and tip stays within maxError of
+// the uncompressed clip at every key, and the result is measured at the
+// keys and half way between them.  Additive clips are measured applied to
+// the reference pose.
+class CompressedClip
+{
+public:
+    CompressedClip();
+
+    // Returns false if no attempt stayed within maxError, the clip then
+    // holds the last attempt and getMeasuredError reports its error
+    bool compress(const Animation &anim, const Rig &rig, float maxError);
+
+    // Same behaviour as samplePose on the source Animation, within maxError
+    void samplePose(float frame, BoneFrame *out, AnimCursor *cursor = NULL) const;
+
+    size_t sizeInBytes() const;
+    // Largest model space error measured while compressing
+    float getMeasuredError() const { return measuredError_; }
+
+private:
+    enum TrackFlags
+    {
+        STATIC_ROT = 1,
+        CONSTANT_ROT = 2,
+        STATIC_LENGTH = 4,
+        CONSTANT_LENGTH = 8
+    };
+
+    struct Track
+    {
+        uint8_t flags;
+        uint8_t rotBits;
+        uint8_t lengthBits;
+        glm::quat constRot;
+        float lengthMin, lengthRange;
+        // bit offsets into bits_ of the first key
+        uint32_t rotOffset, lengthOffset;
+    };
+
+    const Rig *rig_;
+    int numframes_;
+    bool additive_;
+    // What static tracks decode to, the reference pose or identity deltas
+    std::vector<BoneFrame> defaultPose_;
+    std::vector<int> keyFrames_;
+    std::vector<Track> tracks_;
+    std::vector<uint32_t> bits_;
+    float measuredError_;
+
+    void build(const Animation &anim, const std::vector<float> &rotBudget,
+            const std::vector<float> &lengthBudget, int attempt);
+    float measureError(const Animation &anim) const;
+    void applyToRefPose(BoneFrame *pose) const;
+    void decodeKey(size_t key, BoneFrame *out) const;
+    glm::quat decodeRot(const Track &track, size_t key) const;
+    float decodeLength(const Track &track, size_t key) const;
+};
@@ -0,0 +1,135 @@
+#include "crowd.h"
+#include <algorithm>
+#include <cassert>
+
+Crowd::Crowd(const Rig *rig) :
+    rig_(rig),
+    posePool_(rig->numBones()),
+    sourceBones_(0)
+{
+}
+
+Crowd::~Crowd()
+{
+    resize(0);
+}
+
+void Crowd::resize(size_t numInstances)
+{
+    CrowdInstance inst;
+    inst.anim = NULL;
+    inst.sampler = NULL;
+    inst.retarget = NULL;
+    inst.frame = 0.f;
+    inst.transform = glm::mat4(1.f);
+
+    // New instances start in the reference pose
+    const std::vector<BoneFrame> &refPose = rig_->getRefPose();
+    for (size_t i = numInstances; i < poses_.size(); i++)
+        posePool_.free(poses_[i]);
+    for (size_t i = poses_.size(); i < numInstances; i++)
+    {
+        BoneFrame *pose = posePool_.allocate();
+        std::copy(refPose.begin(), refPose.end(), pose);
+        poses_.push_back(pose);
+    }
+    poses_.resize(numInstances);
+
+    instances_.resize(numInstances, inst);
+    palettes_.resize(numInstances * rig_->numBones());
+}
+
+void Crowd::reserveScratch(int numThreads)
+{
+    size_t sourceBones = 0;
+    for (size_t i = 0; i < instances_.size(); i++)
+        if (instances_[i].retarget)
+            sourceBones = std::max(sourceBones, instances_[i].retarget->numSourceBones());
+
+    sourceBones_ = std::max(sourceBones_, sourceBones);
+    if (sourceScratch_.size() < numThreads * sourceBones_)
+        sourceScratch_.resize(numThreads * sourceBones_);
+}
+
+void Crowd::evaluate()
+{
+    reserveScratch(1);
+    evaluate(0, instances_.size(), 0);
+}
+
+void Crowd::evaluate(size_t begin, size_t end, int thread)
+{
+    assert(begin <= end && end <= instances_.size());
+    if (begin == end)
+        return;
+
+    const size_t numBones = rig_->numBones();
+    BoneFrame *sourcePose = NULL;
+    if (sourceBones_)
+    {
+        const size_t slot = thread * sourceBones_;
+        assert(slot + sourceBones_ <= sourceScratch_.size());
+        sourcePose = &sourceScratch_[slot];
+    }
+    evaluateInstances(*rig_, &instances_[begin], end - begin, &poses_[begin],
+            &palettes_[begin * numBones], sourcePose);
+}
+
+void Crowd::evaluateJob(void *data, size_t begin, size_t end)
+{
+    static_cast<Crowd *>(data)->evaluate(begin, end, JobSystem::threadIndex());
+}
+
+void Crowd::evaluate(JobSystem &jobs, size_t grain)
+{
+    reserveScratch(jobs.numThreads());
+    jobs.parallelFor(instances_.size(), grain, evaluateJob, this);
+}
+
+void Crowd::solveTwoBone(const CrowdLimb *limbs, size_t count)
+{
+    twoBone_.clear();
+    for (size_t i = 0; i < count; i++)
+    {
+        const CrowdLimb &limb = limbs[i];
+        assert(limb.instance < instances_.size());
+        twoBone_.add(*rig_, getPose(limb.instance), getPalette(limb.instance),
+                limb.effector, limb.target, limb.pole);
+    }
+    twoBone_.solve();
+}
+
+void evaluateInstances(const Rig &rig, CrowdInstance *instances, size_t n,
+        BoneFrame *const *poses, glm::mat4 *palettes, BoneFrame *sourcePose)
+{
+    const size_t numBones = rig.numBones();
+    const std::vector<BoneFrame> &refPose = rig.getRefPose();
+
+    for (size_t i = 0; i < n; i++)
+    {
+        CrowdInstance &inst = instances[i];
+        BoneFrame *pose = poses[i];
+
+        BoneFrame *sampled = pose;
+        if (inst.retarget && (inst.sampler || inst.anim))
+        {
+            assert(inst.retarget->numTargetBones() == numBones && sourcePose);
+            sampled = sourcePose;
+        }
+
+        if (inst.sampler)
+            inst.sampler->samplePose(inst.frame, sampled, &inst.cursor);
+        else if (inst.anim && !inst.anim->keyframes.empty())
+            samplePose(*inst.anim, inst.frame, sampled, &inst.cursor);
+        else
+        {
+            std::copy(refPose.begin(), refPose.end(), pose);
+            sampled = pose;
+        }
+
+        if (sampled != pose)
+            inst.retarget->apply(sampled, pose);
+
+        rig.computePalette(pose, inst.transform, palettes + i * numBones);
+    }
+}
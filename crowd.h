@@ -0,0 +1,101 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "rig.h"
+#include "animation.h"
+#include "sampler.h"
+#include "retarget.h"
+#include "jobs.h"
+#include "arena.h"
+#include "ik.h"
+
+// Per instance playback state
+struct CrowdInstance
+{
+    const Animation *anim;
+    // Sampled instead of anim when set, built from the same clip
+    const PoseSampler *sampler;
+    // Set when the clip was authored on another rig, maps its source
+    // rig's poses onto the crowd's rig
+    const RetargetMap *retarget;
+    float frame;
+    AnimCursor cursor;
+    // Model transform of the instance root
+    glm::mat4 transform;
+};
+
+// Two bone IK on one limb of one instance, target and pole are in the same
+// space as the palettes, which include the instance's transform
+struct CrowdLimb
+{
+    size_t instance;
+    int effector;
+    glm::vec3 target;
+    glm::vec3 pole;
+};
+
+// Many characters animated on one shared rig.  The rig is never copied,
+// each instance only owns its pose and palette.  Poses come from a
+// PosePool, so they keep their address as the crowd grows.  Palettes are
+// stored contiguously: instance i's start at i * rig.numBones().
+class Crowd
+{
+public:
+    explicit Crowd(const Rig *rig);
+    ~Crowd();
+
+    void resize(size_t numInstances);
+    size_t size() const { return instances_.size(); }
+    const Rig &getRig() const { return *rig_; }
+
+    CrowdInstance &getInstance(size_t i) { return instances_[i]; }
+    const CrowdInstance &getInstance(size_t i) const { return instances_[i]; }
+
+    // Samples each instance's clip at its frame and computes its palette
+    void evaluate();
+    // Same as evaluate(), split into jobs of grain instances.  Instances are
+    // independent, so the result is identical to the single threaded path.
+    void evaluate(JobSystem &jobs, size_t grain = 16);
+
+    // Post process after evaluate, such as planting feet, every limb is
+    // solved together in one TwoBoneBatch.  Limbs of one instance must not
+    // share bones or hang off one another.
+    void solveTwoBone(const CrowdLimb *limbs, size_t count);
+
+    const BoneFrame *getPose(size_t i) const { return poses_[i]; }
+    const glm::mat4 *getPalette(size_t i) const { return &palettes_[i * rig_->numBones()]; }
+    // Writable, for post processing of your own after evaluate
+    BoneFrame *getPose(size_t i) { return poses_[i]; }
+    glm::mat4 *getPalette(size_t i) { return &palettes_[i * rig_->numBones()]; }
+
+private:
+    const Rig *rig_;
+    std::vector<CrowdInstance> instances_;
+    PosePool posePool_;
+    std::vector<BoneFrame *> poses_;
+    std::vector<glm::mat4> palettes_;
+    // Retargeted clips are sampled on their source rig into one pose per
+    // job thread, sourceBones_ each.  Only grows, so evaluating doesn't
+    // allocate once every clip has been seen.
+    std::vector<BoneFrame> sourceScratch_;
+    size_t sourceBones_;
+    TwoBoneBatch twoBone_;
+
+    void reserveScratch(int numThreads);
+    // Evaluates instances [begin, end) with thread's scratch
+    void evaluate(size_t begin, size_t end, int thread);
+    static void evaluateJob(void *data, size_t begin, size_t end);
+
+    // Not copyable
+    Crowd(const Crowd &);
+    Crowd &operator=(const Crowd &);
+};
+
+// Batch entry point, evaluates n instances of rig into poses, which points
+// at each instance's pose, and palettes, which holds n * rig.numBones()
+// entries.  Instances without a sampler or animation are left in the
+// reference pose.  Advances each instance's cursor.  Retargeted clips are
+// sampled into sourcePose first, which holds the largest numSourceBones()
+// of their maps, it can be NULL when no instance is retargeted.
+void evaluateInstances(const Rig &rig, CrowdInstance *instances, size_t n,
+        BoneFrame *const *poses, glm::mat4 *palettes, BoneFrame *sourcePose);
@@ -0,0 +1,90 @@
+// Local bench addition to this copy of GLM; not part of the upstream
+// release.
+//
+// inverse and determinant of rigid mat4 transforms, scalar against
+// fmat4x4SIMD.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/simd_vec4.hpp>
+#include <glm/gtx/simd_mat4.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+static const std::size_t Count = 1 << 14;
+static const int Repeat = 32;
+
+static float randFloat()
+{
+	return rand() / float(RAND_MAX) * 2.f - 1.f;
+}
+
+static glm::mat4 randMat()
+{
+	glm::mat4 m = glm::translate(glm::mat4(1.f), glm::vec3(randFloat(), randFloat(), randFloat()));
+	return glm::rotate(m, randFloat() * 180.f, glm::vec3(randFloat(), randFloat(), 1.f));
+}
+
+int main()
+{
+	int Error = 0;
+
+	std::vector<glm::mat4> Data(Count);
+	std::vector<glm::simdMat4> DataSIMD(Count);
+	for(std::size_t i = 0; i < Count; ++i)
+	{
+		Data[i] = randMat();
+		DataSIMD[i] = glm::simdMat4(Data[i]);
+	}
+
+	std::vector<glm::mat4> Inverse(Count);
+	std::vector<glm::simdMat4> InverseSIMD(Count);
+
+	std::clock_t TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	for(std::size_t i = 0; i < Count; ++i)
+		Inverse[i] = glm::inverse(Data[i]);
+	std::clock_t TimeScalar = clock() - TimeStart;
+
+	TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	for(std::size_t i = 0; i < Count; ++i)
+		InverseSIMD[i] = glm::inverse(DataSIMD[i]);
+	std::clock_t TimeSIMD = clock() - TimeStart;
+
+	float Diff = 0.f;
+	for(std::size_t i = 0; i < Count; ++i)
+	{
+		glm::mat4 m = glm::mat4_cast(InverseSIMD[i]);
+		for(int c = 0; c < 4; ++c)
+		for(int k = 0; k < 4; ++k)
+			Diff = glm::max(Diff, glm::abs(m[c][k] - Inverse[i][c][k]));
+	}
+	printf("inverse:      scalar %ld, SIMD %ld, max diff %g\n", long(TimeScalar), long(TimeSIMD), Diff);
+	Error += Diff < 1e-4f ? 0 : 1;
+
+	std::vector<float> Det(Count), DetSIMD(Count);
+
+	TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	for(std::size_t i = 0; i < Count; ++i)
+		Det[i] = glm::determinant(Data[i]);
+	TimeScalar = clock() - TimeStart;
+
+	TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	for(std::size_t i = 0; i < Count; ++i)
+		DetSIMD[i] = glm::determinant(DataSIMD[i]);
+	TimeSIMD = clock() - TimeStart;
+
+	// Rigid transforms, so every determinant should be one
+	Diff = 0.f;
+	for(std::size_t i = 0; i < Count; ++i)
+		Diff = glm::max(Diff, glm::abs(DetSIMD[i] - Det[i]));
+	printf("determinant:  scalar %ld, SIMD %ld, max diff %g\n", long(TimeScalar), long(TimeSIMD), Diff);
+	Error += Diff < 1e-4f ? 0 : 1;
+
+	return Error;
+}
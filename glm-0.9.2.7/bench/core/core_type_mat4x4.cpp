@@ -0,0 +1,111 @@
+// Local bench addition to this copy of GLM; not part of the upstream
+// release.
+//
+// mat4 * mat4 and mat4 * vec4, scalar against fmat4x4SIMD.  The chained
+// products are the shape of a bone palette, each entry built from its
+// parent's.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/simd_vec4.hpp>
+#include <glm/gtx/simd_mat4.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+static const std::size_t Count = 1 << 14;
+static const int Repeat = 64;
+
+static float randFloat()
+{
+	return rand() / float(RAND_MAX) * 2.f - 1.f;
+}
+
+static glm::mat4 randMat()
+{
+	glm::mat4 m = glm::translate(glm::mat4(1.f), glm::vec3(randFloat(), randFloat(), randFloat()));
+	return glm::rotate(m, randFloat() * 180.f, glm::vec3(randFloat(), randFloat(), 1.f));
+}
+
+static float maxDiff(glm::mat4 const & a, glm::mat4 const & b)
+{
+	float Diff = 0.f;
+	for(int c = 0; c < 4; ++c)
+	for(int r = 0; r < 4; ++r)
+		Diff = glm::max(Diff, glm::abs(a[c][r] - b[c][r]));
+	return Diff;
+}
+
+int main()
+{
+	int Error = 0;
+
+	std::vector<glm::mat4> Data(Count);
+	std::vector<glm::simdMat4> DataSIMD(Count);
+	std::vector<glm::vec4> Vec(Count);
+	std::vector<glm::simdVec4> VecSIMD(Count);
+	for(std::size_t i = 0; i < Count; ++i)
+	{
+		Data[i] = randMat();
+		DataSIMD[i] = glm::simdMat4(Data[i]);
+		Vec[i] = glm::vec4(randFloat(), randFloat(), randFloat(), 1.f);
+		VecSIMD[i] = glm::simdVec4(Vec[i]);
+	}
+
+	// Chained products, every result feeds the next
+	std::vector<glm::mat4> Chain(Count);
+	std::vector<glm::simdMat4> ChainSIMD(Count);
+
+	std::clock_t TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	{
+		Chain[0] = Data[0];
+		for(std::size_t i = 1; i < Count; ++i)
+			Chain[i] = Chain[(i - 1) / 2] * Data[i];
+	}
+	std::clock_t TimeScalar = clock() - TimeStart;
+
+	TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	{
+		ChainSIMD[0] = DataSIMD[0];
+		for(std::size_t i = 1; i < Count; ++i)
+			ChainSIMD[i] = ChainSIMD[(i - 1) / 2] * DataSIMD[i];
+	}
+	std::clock_t TimeSIMD = clock() - TimeStart;
+
+	float Diff = 0.f;
+	for(std::size_t i = 0; i < Count; ++i)
+		Diff = glm::max(Diff, maxDiff(Chain[i], glm::mat4_cast(ChainSIMD[i])));
+	printf("mat4 * mat4:  scalar %ld, SIMD %ld, max diff %g\n", long(TimeScalar), long(TimeSIMD), Diff);
+	Error += Diff < 1e-4f ? 0 : 1;
+
+	// Transforming points
+	std::vector<glm::vec4> Out(Count);
+	std::vector<glm::simdVec4> OutSIMD(Count);
+
+	TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	for(std::size_t i = 0; i < Count; ++i)
+		Out[i] = Data[i] * Vec[i];
+	TimeScalar = clock() - TimeStart;
+
+	TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	for(std::size_t i = 0; i < Count; ++i)
+		OutSIMD[i] = DataSIMD[i] * VecSIMD[i];
+	TimeSIMD = clock() - TimeStart;
+
+	Diff = 0.f;
+	for(std::size_t i = 0; i < Count; ++i)
+	{
+		glm::vec4 v = glm::vec4_cast(OutSIMD[i]);
+		for(int c = 0; c < 4; ++c)
+			Diff = glm::max(Diff, glm::abs(v[c] - Out[i][c]));
+	}
+	printf("mat4 * vec4:  scalar %ld, SIMD %ld, max diff %g\n", long(TimeScalar), long(TimeSIMD), Diff);
+	Error += Diff < 1e-5f ? 0 : 1;
+
+	return Error;
+}
@@ -0,0 +1,135 @@
+// Local bench addition to this copy of GLM; not part of the upstream
+// release.
+//
+// translate then rotate of a parent matrix, the way a bone palette entry
+// is built, with glm::translate/glm::rotate against the same steps done on
+// fmat4x4SIMD columns.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/simd_vec4.hpp>
+#include <glm/gtx/simd_mat4.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+static const std::size_t Count = 1 << 14;
+static const int Repeat = 32;
+
+static float randFloat()
+{
+	return rand() / float(RAND_MAX) * 2.f - 1.f;
+}
+
+// m * translate(v), only the last column changes
+static glm::simdMat4 translateSIMD(glm::simdMat4 const & m, glm::vec3 const & v)
+{
+	glm::simdMat4 Result(m);
+	Result[3] = m[0] * glm::simdVec4(v.x) + m[1] * glm::simdVec4(v.y) + m[2] * glm::simdVec4(v.z) + m[3];
+	return Result;
+}
+
+// m * rotate(angle, axis), the 3x3 rotation is built in scalar code as in
+// glm::rotate then applied to the columns four floats at a time
+static glm::simdMat4 rotateSIMD(glm::simdMat4 const & m, float angle, glm::vec3 const & v)
+{
+	float a = glm::radians(angle);
+	float c = glm::cos(a);
+	float s = glm::sin(a);
+
+	glm::vec3 axis = glm::normalize(v);
+	glm::vec3 temp = (1.f - c) * axis;
+
+	glm::mat3 Rotate;
+	Rotate[0][0] = c + temp[0] * axis[0];
+	Rotate[0][1] = 0 + temp[0] * axis[1] + s * axis[2];
+	Rotate[0][2] = 0 + temp[0] * axis[2] - s * axis[1];
+
+	Rotate[1][0] = 0 + temp[1] * axis[0] - s * axis[2];
+	Rotate[1][1] = c + temp[1] * axis[1];
+	Rotate[1][2] = 0 + temp[1] * axis[2] + s * axis[0];
+
+	Rotate[2][0] = 0 + temp[2] * axis[0] + s * axis[1];
+	Rotate[2][1] = 0 + temp[2] * axis[1] - s * axis[0];
+	Rotate[2][2] = c + temp[2] * axis[2];
+
+	glm::simdMat4 Result;
+	for(int i = 0; i < 3; ++i)
+		Result[i] = m[0] * glm::simdVec4(Rotate[i][0]) + m[1] * glm::simdVec4(Rotate[i][1]) + m[2] * glm::simdVec4(Rotate[i][2]);
+	Result[3] = m[3];
+	return Result;
+}
+
+int main()
+{
+	int Error = 0;
+
+	std::vector<glm::vec3> Offset(Count), Axis(Count);
+	std::vector<float> Angle(Count);
+	for(std::size_t i = 0; i < Count; ++i)
+	{
+		Offset[i] = glm::vec3(randFloat(), randFloat(), randFloat());
+		Axis[i] = glm::vec3(randFloat(), randFloat(), 1.f);
+		Angle[i] = randFloat() * 180.f;
+	}
+
+	// Each entry is built from an earlier one, like a parent in a palette
+	std::vector<glm::mat4> Chain(Count);
+	std::vector<glm::simdMat4> ChainSIMD(Count);
+
+	std::clock_t TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	{
+		Chain[0] = glm::mat4(1.f);
+		for(std::size_t i = 1; i < Count; ++i)
+			Chain[i] = glm::rotate(glm::translate(Chain[(i - 1) / 2], Offset[i]), Angle[i], Axis[i]);
+	}
+	std::clock_t TimeScalar = clock() - TimeStart;
+
+	TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	{
+		ChainSIMD[0] = glm::simdMat4(1.f);
+		for(std::size_t i = 1; i < Count; ++i)
+			ChainSIMD[i] = rotateSIMD(translateSIMD(ChainSIMD[(i - 1) / 2], Offset[i]), Angle[i], Axis[i]);
+	}
+	std::clock_t TimeSIMD = clock() - TimeStart;
+
+	float Diff = 0.f;
+	for(std::size_t i = 0; i < Count; ++i)
+	{
+		glm::mat4 m = glm::mat4_cast(ChainSIMD[i]);
+		for(int c = 0; c < 4; ++c)
+		for(int k = 0; k < 4; ++k)
+			Diff = glm::max(Diff, glm::abs(m[c][k] - Chain[i][c][k]));
+	}
+	printf("translate+rotate: scalar %ld, SIMD %ld, max diff %g\n", long(TimeScalar), long(TimeSIMD), Diff);
+	Error += Diff < 1e-4f ? 0 : 1;
+
+	// translate alone, the cheap half
+	TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	for(std::size_t i = 1; i < Count; ++i)
+		Chain[i] = glm::translate(Chain[i - 1], Offset[i] * 1e-3f);
+	TimeScalar = clock() - TimeStart;
+
+	TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	for(std::size_t i = 1; i < Count; ++i)
+		ChainSIMD[i] = translateSIMD(ChainSIMD[i - 1], Offset[i] * 1e-3f);
+	TimeSIMD = clock() - TimeStart;
+
+	Diff = 0.f;
+	for(std::size_t i = 0; i < Count; ++i)
+	{
+		glm::mat4 m = glm::mat4_cast(ChainSIMD[i]);
+		for(int c = 0; c < 4; ++c)
+		for(int k = 0; k < 4; ++k)
+			Diff = glm::max(Diff, glm::abs(m[c][k] - Chain[i][c][k]));
+	}
+	printf("translate:        scalar %ld, SIMD %ld, max diff %g\n", long(TimeScalar), long(TimeSIMD), Diff);
+	Error += Diff < 1e-3f ? 0 : 1;
+
+	return Error;
+}
@@ -0,0 +1,134 @@
+// Local bench addition to this copy of GLM; not part of the upstream
+// release.
+//
+// The GLM_GTX_quaternion interpolations against gtc mix: shortMix,
+// fastMix, and fastMix done on one fvec4SIMD per quaternion.  Pairs are
+// in opposite hemispheres half the time, which only shortMix and the
+// flipping SIMD version handle, so those are checked against mix with the
+// second quaternion flipped.  toMat4 is checked against mat4_cast.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <glm/gtx/simd_vec4.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+static const std::size_t Count = 1 << 14;
+static const int Repeat = 32;
+
+static float randFloat()
+{
+	return rand() / float(RAND_MAX) * 2.f - 1.f;
+}
+
+static glm::quat randQuat()
+{
+	return glm::normalize(glm::quat(randFloat(), randFloat(), randFloat(), randFloat()));
+}
+
+// Angle in radians between the rotations of two unit quaternions, from
+// atan2 rather than acos, which loses small angles in float
+static float angleBetween(glm::quat const & a, glm::quat const & b)
+{
+	glm::quat d = glm::conjugate(a) * b;
+	return 2.f * glm::atan(glm::length(glm::vec3(d.x, d.y, d.z)), glm::abs(d.w));
+}
+
+// fastMix along the shorter arc, x,y,z,w in one register
+static glm::simdVec4 fastMixSIMD(glm::simdVec4 const & x, glm::simdVec4 const & y, float a)
+{
+	glm::simdVec4 Dot = glm::dot4(x, y);
+	__m128 Flip = _mm_and_ps(_mm_cmplt_ps(Dot.Data, _mm_setzero_ps()), _mm_set1_ps(-0.f));
+	glm::simdVec4 y2(_mm_xor_ps(y.Data, Flip));
+	glm::simdVec4 Result = x * glm::simdVec4(1.f - a) + y2 * glm::simdVec4(a);
+	return Result / glm::niceSqrt(glm::dot4(Result, Result));
+}
+
+int main()
+{
+	int Error = 0;
+
+	// Reference is mix along the shorter arc
+	std::vector<glm::quat> A(Count), B(Count), Ref(Count), Result(Count);
+	std::vector<glm::simdVec4> ASIMD(Count), BSIMD(Count), ResultSIMD(Count);
+	std::vector<float> T(Count);
+	for(std::size_t i = 0; i < Count; ++i)
+	{
+		A[i] = randQuat();
+		B[i] = randQuat();
+		T[i] = rand() / float(RAND_MAX);
+		Ref[i] = glm::mix(A[i], glm::dot(A[i], B[i]) < 0.f ? -B[i] : B[i], T[i]);
+		ASIMD[i] = glm::simdVec4(A[i].x, A[i].y, A[i].z, A[i].w);
+		BSIMD[i] = glm::simdVec4(B[i].x, B[i].y, B[i].z, B[i].w);
+	}
+
+	std::clock_t TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	for(std::size_t i = 0; i < Count; ++i)
+		Result[i] = glm::mix(A[i], B[i], T[i]);
+	printf("mix:          %ld\n", long(clock() - TimeStart));
+
+	TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	for(std::size_t i = 0; i < Count; ++i)
+		Result[i] = glm::shortMix(A[i], B[i], T[i]);
+	std::clock_t Time = clock() - TimeStart;
+
+	float Diff = 0.f;
+	for(std::size_t i = 0; i < Count; ++i)
+		Diff = glm::max(Diff, angleBetween(Result[i], Ref[i]));
+	printf("shortMix:     %ld, max angle diff %g rad\n", long(Time), Diff);
+	Error += Diff < 1e-3f ? 0 : 1;
+
+	TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	for(std::size_t i = 0; i < Count; ++i)
+		Result[i] = glm::fastMix(A[i], B[i], T[i]);
+	Time = clock() - TimeStart;
+
+	// No hemisphere check, so only pairs already on the short arc compare
+	Diff = 0.f;
+	for(std::size_t i = 0; i < Count; ++i)
+		if(glm::dot(A[i], B[i]) >= 0.f)
+			Diff = glm::max(Diff, angleBetween(Result[i], Ref[i]));
+	printf("fastMix:      %ld, max angle diff %g rad (short arc pairs)\n", long(Time), Diff);
+	Error += Diff < 0.15f ? 0 : 1;
+
+	TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	for(std::size_t i = 0; i < Count; ++i)
+		ResultSIMD[i] = fastMixSIMD(ASIMD[i], BSIMD[i], T[i]);
+	Time = clock() - TimeStart;
+
+	Diff = 0.f;
+	for(std::size_t i = 0; i < Count; ++i)
+	{
+		glm::vec4 v = glm::vec4_cast(ResultSIMD[i]);
+		Diff = glm::max(Diff, angleBetween(glm::quat(v.w, v.x, v.y, v.z), Ref[i]));
+	}
+	printf("fastMix SIMD: %ld, max angle diff %g rad\n", long(Time), Diff);
+	Error += Diff < 0.15f ? 0 : 1;
+
+	std::vector<glm::mat4> Mat(Count), MatRef(Count);
+	for(std::size_t i = 0; i < Count; ++i)
+		MatRef[i] = glm::mat4_cast(A[i]);
+
+	TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	for(std::size_t i = 0; i < Count; ++i)
+		Mat[i] = glm::toMat4(A[i]);
+	Time = clock() - TimeStart;
+
+	Diff = 0.f;
+	for(std::size_t i = 0; i < Count; ++i)
+	for(int c = 0; c < 4; ++c)
+	for(int k = 0; k < 4; ++k)
+		Diff = glm::max(Diff, glm::abs(Mat[i][c][k] - MatRef[i][c][k]));
+	printf("toMat4:       %ld, max diff %g\n", long(Time), Diff);
+	Error += Diff == 0.f ? 0 : 1;
+
+	return Error;
+}
@@ -0,0 +1,140 @@
+// Local bench addition to this copy of GLM; not part of the upstream
+// release.
+//
+// vec4 against fvec4SIMD: multiply add, dot, length and normalize.
+// fastNormalize uses the approximate reciprocal square root, its error is
+// reported next to normalize and a division by niceSqrt.
+
+#include <glm/glm.hpp>
+#include <glm/gtx/simd_vec4.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+static const std::size_t Count = 1 << 16;
+static const int Repeat = 64;
+
+static float randFloat()
+{
+	return rand() / float(RAND_MAX) * 2.f - 1.f;
+}
+
+static float maxDiff(std::vector<glm::vec4> const & a, std::vector<glm::simdVec4> const & b)
+{
+	float Diff = 0.f;
+	for(std::size_t i = 0; i < a.size(); ++i)
+	{
+		glm::vec4 v = glm::vec4_cast(b[i]);
+		for(int c = 0; c < 4; ++c)
+			Diff = glm::max(Diff, glm::abs(v[c] - a[i][c]));
+	}
+	return Diff;
+}
+
+int main()
+{
+	int Error = 0;
+
+	std::vector<glm::vec4> A(Count), B(Count), Out(Count);
+	std::vector<glm::simdVec4> ASIMD(Count), BSIMD(Count), OutSIMD(Count);
+	for(std::size_t i = 0; i < Count; ++i)
+	{
+		A[i] = glm::vec4(randFloat(), randFloat(), randFloat(), randFloat());
+		B[i] = glm::vec4(randFloat(), randFloat(), randFloat(), randFloat());
+		ASIMD[i] = glm::simdVec4(A[i]);
+		BSIMD[i] = glm::simdVec4(B[i]);
+	}
+
+	std::clock_t TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	for(std::size_t i = 0; i < Count; ++i)
+		Out[i] = A[i] * B[i] + Out[i];
+	std::clock_t TimeScalar = clock() - TimeStart;
+
+	TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	for(std::size_t i = 0; i < Count; ++i)
+		OutSIMD[i] = ASIMD[i] * BSIMD[i] + OutSIMD[i];
+	std::clock_t TimeSIMD = clock() - TimeStart;
+
+	float Diff = maxDiff(Out, OutSIMD);
+	printf("a * b + c:        scalar %ld, SIMD %ld, max diff %g\n", long(TimeScalar), long(TimeSIMD), Diff);
+	Error += Diff < 1e-4f ? 0 : 1;
+
+	std::vector<float> Dot(Count), DotSIMD(Count);
+
+	TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	for(std::size_t i = 0; i < Count; ++i)
+		Dot[i] = glm::dot(A[i], B[i]);
+	TimeScalar = clock() - TimeStart;
+
+	TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	for(std::size_t i = 0; i < Count; ++i)
+		DotSIMD[i] = glm::simdDot(ASIMD[i], BSIMD[i]);
+	TimeSIMD = clock() - TimeStart;
+
+	Diff = 0.f;
+	for(std::size_t i = 0; i < Count; ++i)
+		Diff = glm::max(Diff, glm::abs(Dot[i] - DotSIMD[i]));
+	printf("dot:              scalar %ld, SIMD %ld, max diff %g\n", long(TimeScalar), long(TimeSIMD), Diff);
+	Error += Diff < 1e-5f ? 0 : 1;
+
+	TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	for(std::size_t i = 0; i < Count; ++i)
+		Dot[i] = glm::length(A[i]);
+	TimeScalar = clock() - TimeStart;
+
+	TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	for(std::size_t i = 0; i < Count; ++i)
+		DotSIMD[i] = glm::niceLength(ASIMD[i]);
+	TimeSIMD = clock() - TimeStart;
+
+	Diff = 0.f;
+	for(std::size_t i = 0; i < Count; ++i)
+		Diff = glm::max(Diff, glm::abs(Dot[i] - DotSIMD[i]));
+	printf("length:           scalar %ld, SIMD %ld, max diff %g\n", long(TimeScalar), long(TimeSIMD), Diff);
+	Error += Diff < 1e-5f ? 0 : 1;
+
+	TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	for(std::size_t i = 0; i < Count; ++i)
+		Out[i] = glm::normalize(A[i]);
+	TimeScalar = clock() - TimeStart;
+
+	TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	for(std::size_t i = 0; i < Count; ++i)
+		OutSIMD[i] = glm::normalize(ASIMD[i]);
+	TimeSIMD = clock() - TimeStart;
+
+	Diff = maxDiff(Out, OutSIMD);
+	printf("normalize:        scalar %ld, SIMD %ld, max diff %g\n", long(TimeScalar), long(TimeSIMD), Diff);
+	Error += Diff < 1e-5f ? 0 : 1;
+
+	TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	for(std::size_t i = 0; i < Count; ++i)
+		OutSIMD[i] = glm::fastNormalize(ASIMD[i]);
+	TimeSIMD = clock() - TimeStart;
+
+	Diff = maxDiff(Out, OutSIMD);
+	printf("fastNormalize:    scalar %ld, SIMD %ld, max diff %g\n", long(TimeScalar), long(TimeSIMD), Diff);
+	Error += Diff < 1e-2f ? 0 : 1;
+
+	TimeStart = clock();
+	for(int r = 0; r < Repeat; ++r)
+	for(std::size_t i = 0; i < Count; ++i)
+		OutSIMD[i] = ASIMD[i] / glm::niceSqrt(glm::dot4(ASIMD[i], ASIMD[i]));
+	TimeSIMD = clock() - TimeStart;
+
+	Diff = maxDiff(Out, OutSIMD);
+	printf("normalize exact:  scalar %ld, SIMD %ld, max diff %g\n", long(TimeScalar), long(TimeSIMD), Diff);
+	Error += Diff < 1e-5f ? 0 : 1;
+
+	return Error;
+}
@@ -147,7 +147,11 @@ namespace detail
 		fmat4x4SIMD const & m
 	)
     {
-		sse_mul_ps(&this->Data[0].Data, &m.Data[0].Data, &this->Data[0].Data);
+		// sse_mul_ps reads in1 after writing out, so they can't alias
+		__m128 Result[4];
+		sse_mul_ps(&this->Data[0].Data, &m.Data[0].Data, Result);
+		for(int i = 0; i < 4; ++i)
+			this->Data[i].Data = Result[i];
         return *this;
     }
 
@@ -156,9 +160,11 @@ namespace detail
 		fmat4x4SIMD const & m
 	)
     {
-		__m128 Inv[4];
+		__m128 Inv[4], Result[4];
 		sse_inverse_ps(&m.Data[0].Data, Inv);
-		sse_mul_ps(&this->Data[0].Data, Inv, &this->Data[0].Data);
+		sse_mul_ps(&this->Data[0].Data, Inv, Result);
+		for(int i = 0; i < 4; ++i)
+			this->Data[i].Data = Result[i];
         return *this;
     }
 
@@ -232,6 +238,130 @@ namespace detail
         return *this;
     }
 
+	//////////////////////////////////////
+	// Binary operators
+
+	GLM_FUNC_QUALIFIER fmat4x4SIMD operator+ (fmat4x4SIMD const & m, float const & s)
+	{
+		fmat4x4SIMD Result(m);
+		return Result += s;
+	}
+
+	GLM_FUNC_QUALIFIER fmat4x4SIMD operator+ (float const & s, fmat4x4SIMD const & m)
+	{
+		fmat4x4SIMD Result(m);
+		return Result += s;
+	}
+
+	GLM_FUNC_QUALIFIER fmat4x4SIMD operator+ (fmat4x4SIMD const & m1, fmat4x4SIMD const & m2)
+	{
+		fmat4x4SIMD Result(m1);
+		return Result += m2;
+	}
+
+	GLM_FUNC_QUALIFIER fmat4x4SIMD operator- (fmat4x4SIMD const & m, float const & s)
+	{
+		fmat4x4SIMD Result(m);
+		return Result -= s;
+	}
+
+	GLM_FUNC_QUALIFIER fmat4x4SIMD operator- (float const & s, fmat4x4SIMD const & m)
+	{
+		__m128 Operand = _mm_set_ps1(s);
+		fmat4x4SIMD Result;
+		for(int i = 0; i < 4; ++i)
+			Result[i].Data = _mm_sub_ps(Operand, m[i].Data);
+		return Result;
+	}
+
+	GLM_FUNC_QUALIFIER fmat4x4SIMD operator- (fmat4x4SIMD const & m1, fmat4x4SIMD const & m2)
+	{
+		fmat4x4SIMD Result(m1);
+		return Result -= m2;
+	}
+
+	GLM_FUNC_QUALIFIER fmat4x4SIMD operator* (fmat4x4SIMD const & m, float const & s)
+	{
+		fmat4x4SIMD Result(m);
+		return Result *= s;
+	}
+
+	GLM_FUNC_QUALIFIER fmat4x4SIMD operator* (float const & s, fmat4x4SIMD const & m)
+	{
+		fmat4x4SIMD Result(m);
+		return Result *= s;
+	}
+
+	GLM_FUNC_QUALIFIER fvec4SIMD operator* (fmat4x4SIMD const & m, fvec4SIMD const & v)
+	{
+		return sse_mul_ps(const_cast<__m128 *>(&m.Data[0].Data), v.Data);
+	}
+
+	GLM_FUNC_QUALIFIER fvec4SIMD operator* (fvec4SIMD const & v, fmat4x4SIMD const & m)
+	{
+		return sse_mul_ps(v.Data, const_cast<__m128 *>(&m.Data[0].Data));
+	}
+
+	GLM_FUNC_QUALIFIER fmat4x4SIMD operator* (fmat4x4SIMD const & m1, fmat4x4SIMD const & m2)
+	{
+		fmat4x4SIMD Result;
+		sse_mul_ps(&m1.Data[0].Data, &m2.Data[0].Data, &Result.Data[0].Data);
+		return Result;
+	}
+
+	GLM_FUNC_QUALIFIER fmat4x4SIMD operator/ (fmat4x4SIMD const & m, float const & s)
+	{
+		fmat4x4SIMD Result(m);
+		return Result /= s;
+	}
+
+	GLM_FUNC_QUALIFIER fmat4x4SIMD operator/ (float const & s, fmat4x4SIMD const & m)
+	{
+		__m128 Operand = _mm_set_ps1(s);
+		fmat4x4SIMD Result;
+		for(int i = 0; i < 4; ++i)
+			Result[i].Data = _mm_div_ps(Operand, m[i].Data);
+		return Result;
+	}
+
+	GLM_FUNC_QUALIFIER fvec4SIMD operator/ (fmat4x4SIMD const & m, fvec4SIMD const & v)
+	{
+		__m128 Inv[4];
+		sse_inverse_ps(&m.Data[0].Data, Inv);
+		return sse_mul_ps(Inv, v.Data);
+	}
+
+	GLM_FUNC_QUALIFIER fvec4SIMD operator/ (fvec4SIMD const & v, fmat4x4SIMD const & m)
+	{
+		__m128 Inv[4];
+		sse_inverse_ps(&m.Data[0].Data, Inv);
+		return sse_mul_ps(v.Data, Inv);
+	}
+
+	GLM_FUNC_QUALIFIER fmat4x4SIMD operator/ (fmat4x4SIMD const & m1, fmat4x4SIMD const & m2)
+	{
+		fmat4x4SIMD Result(m1);
+		return Result /= m2;
+	}
+
+	//////////////////////////////////////
+	// Unary constant operators
+
+	GLM_FUNC_QUALIFIER fmat4x4SIMD const operator- (fmat4x4SIMD const & m)
+	{
+		return 0.f - m;
+	}
+
+	GLM_FUNC_QUALIFIER fmat4x4SIMD const operator-- (fmat4x4SIMD const & m, int)
+	{
+		return m - 1.f;
+	}
+
+	GLM_FUNC_QUALIFIER fmat4x4SIMD const operator++ (fmat4x4SIMD const & m, int)
+	{
+		return m + 1.f;
+	}
+
 }//namespace detail
 
 namespace gtx{
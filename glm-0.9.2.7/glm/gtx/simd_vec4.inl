@@ -623,6 +623,16 @@ namespace glm
 			return Result;
 		}
 
+		// Declared as simdDot in simd_vec4.hpp
+		GLM_FUNC_QUALIFIER float simdDot
+		(
+			detail::fvec4SIMD const & x,
+			detail::fvec4SIMD const & y
+		)
+		{
+			return dot(x, y);
+		}
+
 		GLM_FUNC_QUALIFIER detail::fvec4SIMD dot4
 		(
 			detail::fvec4SIMD const & x,
@@ -0,0 +1,657 @@
+#include "ik.h"
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+#include <glm/gtx/simd_vec4.hpp>
+#endif
+
+namespace
+{
+
+// The chain and enough of the rig to keep the palette in step with it
+struct Chain
+{
+    const Rig *rig;
+    BoneFrame *pose;
+    glm::mat4 *palette;
+
+    // Bones from the chain root to the effector
+    int bones[MAX_IK_CHAIN];
+    int length;
+    // Chain root's palette entry without its own rotation, everything
+    // above the chain stays put while solving
+    glm::mat4 rootBase;
+
+    int effector() const { return bones[length - 1]; }
+
+    glm::vec3 tip() const
+    {
+        const int e = effector();
+        return glm::vec3(palette[e] * glm::vec4(pose[e].length, 0.f, 0.f, 1.f));
+    }
+
+    // Vector from chain bone k's base to the next joint, in k's space
+    glm::vec3 segment(int k) const
+    {
+        if (k == length - 1)
+            return glm::vec3(pose[bones[k]].length, 0.f, 0.f);
+        return rig->getBoneOffset(pose, bones[k + 1]);
+    }
+
+    // Rebuilds one palette entry from its parent's, which must be current
+    void refresh(int bone)
+    {
+        const glm::mat4 rotation = glm::mat4_cast(pose[bone].rot);
+        if (bone == bones[0])
+            palette[bone] = rootBase * rotation;
+        else
+            palette[bone] = glm::translate(palette[rig->getParent(bone)],
+                    rig->getBoneOffset(pose, bone)) * rotation;
+    }
+
+    void refreshChain()
+    {
+        for (int k = 0; k < length; k++)
+            refresh(bones[k]);
+    }
+
+    // Brings the bones hanging off the chain back in line
+    void refreshSubtree()
+    {
+        const int end = rig->getSubtreeEnd(bones[0]);
+        for (int bone = bones[0]; bone < end; bone++)
+            refresh(bone);
+    }
+};
+
+void buildChain(const Rig &rig, BoneFrame *pose, glm::mat4 *palette,
+        int root, int effector, Chain &chain)
+{
+    chain.rig = &rig;
+    chain.pose = pose;
+    chain.palette = palette;
+
+    // Walk up from the effector, then flip into root first order
+    int count = 0;
+    for (int bone = effector; ; bone = rig.getParent(bone))
+    {
+        assert(bone >= 0 && "IK root is not an ancestor of the effector");
+        assert(count < MAX_IK_CHAIN && "IK chain too long");
+        chain.bones[count++] = bone;
+        if (bone == root)
+            break;
+    }
+    for (int i = 0; i < count / 2; i++)
+        std::swap(chain.bones[i], chain.bones[count - 1 - i]);
+    chain.length = count;
+
+    chain.rootBase = palette[root] * glm::mat4_cast(glm::conjugate(pose[root].rot));
+}
+
+// Turns each chain bone, root first, so its segment points at the next of
+// joints, which holds the chain length plus one positions
+void alignChain(Chain &chain, const glm::vec3 *joints)
+{
+    for (int k = 0; k < chain.length; k++)
+    {
+        const int bone = chain.bones[k];
+        chain.refresh(bone);
+
+        const glm::vec3 desired = glm::transpose(glm::mat3(chain.palette[bone])) *
+            (joints[k + 1] - glm::vec3(chain.palette[bone][3]));
+        const glm::vec3 segment = chain.segment(k);
+        if (glm::dot(segment, segment) < 1e-12f || glm::dot(desired, desired) < 1e-12f)
+            continue;
+
+        chain.pose[bone].rot = glm::normalize(chain.pose[bone].rot *
+                rotationBetween(segment, desired));
+        // The next bone is placed from this entry
+        chain.refresh(bone);
+    }
+}
+
+const float TWO_BONE_EPSILON = 1e-6f;
+
+// Solved middle joint and tip for a two bone limb rooted at root.  The bend
+// plane comes from pole, or the current middle joint when the pole is on
+// the line to the target.  TwoBoneBatch does the same maths in SIMD.
+void twoBoneJoints(const glm::vec3 &root, const glm::vec3 &mid, const glm::vec3 &target,
+        const glm::vec3 &pole, float upper, float lower, glm::vec3 &outMid, glm::vec3 &outTip)
+{
+    const glm::vec3 toTarget = target - root;
+    const float dist = glm::length(toTarget);
+    const glm::vec3 dir = toTarget / std::max(dist, TWO_BONE_EPSILON);
+    const float d = std::min(std::max(dist, fabsf(upper - lower)), upper + lower);
+
+    glm::vec3 bend = (pole - root) - dir * glm::dot(pole - root, dir);
+    if (glm::dot(bend, bend) < TWO_BONE_EPSILON * TWO_BONE_EPSILON)
+        bend = (mid - root) - dir * glm::dot(mid - root, dir);
+    bend /= sqrtf(std::max(glm::dot(bend, bend), TWO_BONE_EPSILON * TWO_BONE_EPSILON));
+
+    // Law of cosines for the angle at the root
+    float cosangle = (upper * upper + d * d - lower * lower) /
+        (2.f * upper * std::max(d, TWO_BONE_EPSILON));
+    cosangle = glm::clamp(cosangle, -1.f, 1.f);
+    const float sinangle = sqrtf(std::max(0.f, 1.f - cosangle * cosangle));
+
+    outMid = root + dir * (upper * cosangle) + bend * (upper * sinangle);
+    outTip = root + dir * d;
+}
+
+// Point at distance d from anchor in the direction of from
+glm::vec3 placeJoint(const glm::vec3 &from, const glm::vec3 &anchor, float d)
+{
+    glm::vec3 dir = from - anchor;
+    float len = glm::length(dir);
+    if (len < 1e-6f)
+        return anchor + glm::vec3(d, 0.f, 0.f);
+    return anchor + dir * (d / len);
+}
+
+} // namespace
+
+glm::quat rotationBetween(const glm::vec3 &from, const glm::vec3 &to)
+{
+    const glm::vec3 a = glm::normalize(from);
+    const glm::vec3 b = glm::normalize(to);
+
+    // (1 + cos, sin * axis) is the half angle rotation, normalizing it needs
+    // no trig.  Opposite directions need an explicit perpendicular axis.
+    float cosangle = glm::dot(a, b);
+    if (cosangle < -0.9999f)
+    {
+        glm::vec3 axis = glm::cross(glm::vec3(1.f, 0.f, 0.f), a);
+        if (glm::dot(axis, axis) < 1e-6f)
+            axis = glm::cross(glm::vec3(0.f, 1.f, 0.f), a);
+        return glm::quat(0.f, glm::normalize(axis));
+    }
+    return glm::normalize(glm::quat(1.f + cosangle, glm::cross(a, b)));
+}
+
+float solveCCD(const Rig &rig, BoneFrame *pose, glm::mat4 *palette,
+        int root, int effector, const glm::vec3 &target, const IKParams &params)
+{
+    Chain chain;
+    buildChain(rig, pose, palette, root, effector, chain);
+
+    glm::vec3 tip = chain.tip();
+    for (int iter = 0; iter < params.maxIterations; iter++)
+    {
+        if (glm::length(target - tip) <= params.tolerance)
+            break;
+
+        // Turning a bone only moves what is below it, so walking up from
+        // the effector every palette entry read is still current.  Only
+        // the tip is carried along.
+        for (int k = chain.length - 1; k >= 0; k--)
+        {
+            const int bone = chain.bones[k];
+            const glm::mat3 rotation(palette[bone]);
+            const glm::mat3 inverse = glm::transpose(rotation);
+            const glm::vec3 base(palette[bone][3]);
+
+            const glm::vec3 toTip = inverse * (tip - base);
+            const glm::vec3 toTarget = inverse * (target - base);
+            if (glm::dot(toTip, toTip) < 1e-12f || glm::dot(toTarget, toTarget) < 1e-12f)
+                continue;
+
+            const glm::quat delta = rotationBetween(toTip, toTarget);
+            pose[bone].rot = glm::normalize(pose[bone].rot * delta);
+            tip = base + rotation * (delta * toTip);
+        }
+
+        chain.refreshChain();
+        tip = chain.tip();
+    }
+
+    chain.refreshSubtree();
+    return glm::length(target - chain.tip());
+}
+
+float solveFABRIK(const Rig &rig, BoneFrame *pose, glm::mat4 *palette,
+        int root, int effector, const glm::vec3 &target, const IKParams &params)
+{
+    Chain chain;
+    buildChain(rig, pose, palette, root, effector, chain);
+
+    // Joint positions, the chain bases and then the effector tip
+    const int n = chain.length;
+    glm::vec3 joints[MAX_IK_CHAIN + 1];
+    float lengths[MAX_IK_CHAIN];
+    float reach = 0.f;
+    for (int k = 0; k < n; k++)
+        joints[k] = glm::vec3(palette[chain.bones[k]][3]);
+    joints[n] = chain.tip();
+    for (int k = 0; k < n; k++)
+    {
+        lengths[k] = glm::length(chain.segment(k));
+        reach += lengths[k];
+    }
+
+    const glm::vec3 base = joints[0];
+    if (glm::length(target - base) >= reach)
+    {
+        for (int k = 0; k < n; k++)
+            joints[k + 1] = placeJoint(target, joints[k], lengths[k]);
+    }
+    else
+    {
+        for (int iter = 0; iter < params.maxIterations; iter++)
+        {
+            if (glm::length(target - joints[n]) <= params.tolerance)
+                break;
+
+            joints[n] = target;
+            for (int k = n - 1; k >= 0; k--)
+                joints[k] = placeJoint(joints[k], joints[k + 1], lengths[k]);
+
+            joints[0] = base;
+            for (int k = 0; k < n; k++)
+                joints[k + 1] = placeJoint(joints[k + 1], joints[k], lengths[k]);
+        }
+    }
+
+    alignChain(chain, joints);
+    chain.refreshSubtree();
+    return glm::length(target - chain.tip());
+}
+
+float solveTwoBone(const Rig &rig, BoneFrame *pose, glm::mat4 *palette,
+        int effector, const glm::vec3 &target, const glm::vec3 &pole)
+{
+    const int upper = rig.getParent(effector);
+    assert(upper >= 0 && "two bone IK effector needs a parent");
+
+    Chain chain;
+    buildChain(rig, pose, palette, upper, effector, chain);
+
+    glm::vec3 joints[3];
+    joints[0] = glm::vec3(palette[upper][3]);
+    twoBoneJoints(joints[0], glm::vec3(palette[effector][3]), target, pole,
+            glm::length(chain.segment(0)), pose[effector].length, joints[1], joints[2]);
+
+    alignChain(chain, joints);
+    chain.refreshSubtree();
+    return glm::length(target - chain.tip());
+}
+
+TwoBoneBatch::TwoBoneBatch()
+{
+}
+
+void TwoBoneBatch::clear()
+{
+    limbs_.clear();
+    for (int l = 0; l < NUM_LANES; l++)
+        lanes_[l].clear();
+}
+
+void TwoBoneBatch::add(const Rig &rig, BoneFrame *pose, glm::mat4 *palette,
+        int effector, const glm::vec3 &target, const glm::vec3 &pole)
+{
+    const int upper = rig.getParent(effector);
+    assert(upper >= 0 && "two bone IK effector needs a parent");
+
+    Limb limb;
+    limb.rig = &rig;
+    limb.pose = pose;
+    limb.palette = palette;
+    limb.effector = effector;
+    limbs_.push_back(limb);
+
+    const glm::mat4 &m = palette[upper];
+    const glm::vec3 mid(palette[effector][3]);
+    const glm::vec3 offset = rig.getBoneOffset(pose, effector);
+    const glm::quat &ru = pose[upper].rot, &rl = pose[effector].rot;
+    const float values[NUM_LANES] = {
+        m[3].x, m[3].y, m[3].z,
+        m[0].x, m[0].y, m[0].z,
+        m[1].x, m[1].y, m[1].z,
+        m[2].x, m[2].y, m[2].z,
+        mid.x, mid.y, mid.z,
+        0, 0, 0, 0, 0, 0, 0, 0, 0,
+        target.x, target.y, target.z,
+        pole.x, pole.y, pole.z,
+        offset.x, offset.y, offset.z,
+        pose[effector].length,
+        ru.w, ru.x, ru.y, ru.z,
+        rl.w, rl.x, rl.y, rl.z
+    };
+    for (int l = 0; l < NUM_LANES; l++)
+        lanes_[l].push_back(values[l]);
+}
+
+void TwoBoneBatch::writeBack(size_t i)
+{
+    const Limb &limb = limbs_[i];
+    const Rig &rig = *limb.rig;
+    const int effector = limb.effector;
+    const int upper = rig.getParent(effector);
+
+    limb.pose[upper].rot = glm::quat(lanes_[UPPER_ROT_W][i], lanes_[UPPER_ROT_X][i],
+            lanes_[UPPER_ROT_Y][i], lanes_[UPPER_ROT_Z][i]);
+    limb.pose[effector].rot = glm::quat(lanes_[LOWER_ROT_W][i], lanes_[LOWER_ROT_X][i],
+            lanes_[LOWER_ROT_Y][i], lanes_[LOWER_ROT_Z][i]);
+
+    // The upper bone keeps its base, the effector moves to the solved one
+    glm::mat4 &u = limb.palette[upper];
+    glm::mat4 &e = limb.palette[effector];
+    for (int c = 0; c < 3; c++)
+    {
+        u[c] = glm::vec4(lanes_[UPPER_XX + 3 * c][i], lanes_[UPPER_XY + 3 * c][i],
+                lanes_[UPPER_XZ + 3 * c][i], 0.f);
+        e[c] = glm::vec4(lanes_[LOWER_XX + 3 * c][i], lanes_[LOWER_XY + 3 * c][i],
+                lanes_[LOWER_XZ + 3 * c][i], 0.f);
+    }
+    e[3] = glm::vec4(lanes_[MID_X][i], lanes_[MID_Y][i], lanes_[MID_Z][i], 1.f);
+
+    // Everything else below the limb follows from those two
+    const int end = rig.getSubtreeEnd(upper);
+    for (int bone = upper + 1; bone < end; bone++)
+    {
+        if (bone == effector)
+            continue;
+        limb.palette[bone] = glm::translate(limb.palette[rig.getParent(bone)],
+                rig.getBoneOffset(limb.pose, bone)) * glm::mat4_cast(limb.pose[bone].rot);
+    }
+}
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+namespace
+{
+
+// Four limbs' worth of one vector
+struct Vec3x4
+{
+    glm::simdVec4 x, y, z;
+
+    Vec3x4() {}
+    Vec3x4(const glm::simdVec4 &x, const glm::simdVec4 &y, const glm::simdVec4 &z) :
+        x(x), y(y), z(z) {}
+
+    Vec3x4 operator+(const Vec3x4 &v) const { return Vec3x4(x + v.x, y + v.y, z + v.z); }
+    Vec3x4 operator-(const Vec3x4 &v) const { return Vec3x4(x - v.x, y - v.y, z - v.z); }
+    Vec3x4 operator*(const glm::simdVec4 &s) const { return Vec3x4(x * s, y * s, z * s); }
+};
+
+// Four quaternions, and four 3x3 rotations stored by column
+struct Quat4
+{
+    glm::simdVec4 w, x, y, z;
+};
+
+struct Mat3x4
+{
+    Vec3x4 col[3];
+};
+
+glm::simdVec4 dot(const Vec3x4 &a, const Vec3x4 &b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+Vec3x4 cross(const Vec3x4 &a, const Vec3x4 &b)
+{
+    return Vec3x4(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+// mask ? a : b, per lane
+glm::simdVec4 select(__m128 mask, const glm::simdVec4 &a, const glm::simdVec4 &b)
+{
+    return glm::simdVec4(_mm_or_ps(_mm_and_ps(mask, a.Data), _mm_andnot_ps(mask, b.Data)));
+}
+
+Vec3x4 select(__m128 mask, const Vec3x4 &a, const Vec3x4 &b)
+{
+    return Vec3x4(select(mask, a.x, b.x), select(mask, a.y, b.y), select(mask, a.z, b.z));
+}
+
+Quat4 select(__m128 mask, const Quat4 &a, const Quat4 &b)
+{
+    Quat4 q;
+    q.w = select(mask, a.w, b.w);
+    q.x = select(mask, a.x, b.x);
+    q.y = select(mask, a.y, b.y);
+    q.z = select(mask, a.z, b.z);
+    return q;
+}
+
+Vec3x4 normalize(const Vec3x4 &v)
+{
+    return v * (glm::simdVec4(1.f) / glm::niceSqrt(dot(v, v)));
+}
+
+Quat4 normalize(const Quat4 &q)
+{
+    const glm::simdVec4 inv = glm::simdVec4(1.f) /
+        glm::niceSqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+    Quat4 r;
+    r.w = q.w * inv;
+    r.x = q.x * inv;
+    r.y = q.y * inv;
+    r.z = q.z * inv;
+    return r;
+}
+
+// Same product as glm's quat * quat
+Quat4 operator*(const Quat4 &q, const Quat4 &p)
+{
+    Quat4 r;
+    r.w = q.w * p.w - q.x * p.x - q.y * p.y - q.z * p.z;
+    r.x = q.w * p.x + q.x * p.w + q.y * p.z - q.z * p.y;
+    r.y = q.w * p.y + q.y * p.w + q.z * p.x - q.x * p.z;
+    r.z = q.w * p.z + q.z * p.w + q.x * p.y - q.y * p.x;
+    return r;
+}
+
+// Same entries as glm::mat3_cast
+Mat3x4 toMat3(const Quat4 &q)
+{
+    const glm::simdVec4 one(1.f), two(2.f);
+    const glm::simdVec4 xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    const glm::simdVec4 xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    const glm::simdVec4 wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+    Mat3x4 m;
+    m.col[0] = Vec3x4(one - two * (yy + zz), two * (xy + wz), two * (xz - wy));
+    m.col[1] = Vec3x4(two * (xy - wz), one - two * (xx + zz), two * (yz + wx));
+    m.col[2] = Vec3x4(two * (xz + wy), two * (yz - wx), one - two * (xx + yy));
+    return m;
+}
+
+Vec3x4 operator*(const Mat3x4 &m, const Vec3x4 &v)
+{
+    return m.col[0] * v.x + m.col[1] * v.y + m.col[2] * v.z;
+}
+
+// transpose(m) * v, m being a rotation this takes v into its space
+Vec3x4 inverseRotate(const Mat3x4 &m, const Vec3x4 &v)
+{
+    return Vec3x4(dot(m.col[0], v), dot(m.col[1], v), dot(m.col[2], v));
+}
+
+Mat3x4 operator*(const Mat3x4 &a, const Mat3x4 &b)
+{
+    Mat3x4 m;
+    for (int c = 0; c < 3; c++)
+        m.col[c] = a * b.col[c];
+    return m;
+}
+
+// rotationBetween for four pairs, identity where either direction is too
+// short to have one, as alignChain skips those
+Quat4 rotationBetween(const Vec3x4 &from, const Vec3x4 &to)
+{
+    const glm::simdVec4 zero(0.f), one(1.f), tiny(1e-12f);
+    const Vec3x4 a = normalize(from), b = normalize(to);
+    const glm::simdVec4 cosangle = dot(a, b);
+
+    Quat4 q;
+    q.w = one + cosangle;
+    const Vec3x4 axis = cross(a, b);
+    q.x = axis.x;
+    q.y = axis.y;
+    q.z = axis.z;
+    q = normalize(q);
+
+    // Opposite directions, turn half way round an axis perpendicular to from
+    Vec3x4 perp(zero, zero - a.z, a.y);
+    perp = select(_mm_cmplt_ps(dot(perp, perp).Data, glm::simdVec4(1e-6f).Data),
+            Vec3x4(a.z, zero, zero - a.x), perp);
+    perp = normalize(perp);
+    Quat4 half;
+    half.w = zero;
+    half.x = perp.x;
+    half.y = perp.y;
+    half.z = perp.z;
+    q = select(_mm_cmplt_ps(cosangle.Data, glm::simdVec4(-0.9999f).Data), half, q);
+
+    Quat4 identity;
+    identity.w = one;
+    identity.x = identity.y = identity.z = zero;
+    const __m128 degenerate = _mm_or_ps(_mm_cmplt_ps(dot(from, from).Data, tiny.Data),
+            _mm_cmplt_ps(dot(to, to).Data, tiny.Data));
+    return select(degenerate, identity, q);
+}
+
+glm::simdVec4 load(const std::vector<float> &lane, size_t i)
+{
+    return glm::simdVec4(_mm_loadu_ps(&lane[i]));
+}
+
+Vec3x4 load(const std::vector<float> *lanes, int first, size_t i)
+{
+    return Vec3x4(load(lanes[first], i), load(lanes[first + 1], i), load(lanes[first + 2], i));
+}
+
+Quat4 loadQuat(const std::vector<float> *lanes, int first, size_t i)
+{
+    Quat4 q;
+    q.w = load(lanes[first], i);
+    q.x = load(lanes[first + 1], i);
+    q.y = load(lanes[first + 2], i);
+    q.z = load(lanes[first + 3], i);
+    return q;
+}
+
+Mat3x4 loadMat(const std::vector<float> *lanes, int first, size_t i)
+{
+    Mat3x4 m;
+    for (int c = 0; c < 3; c++)
+        m.col[c] = load(lanes, first + 3 * c, i);
+    return m;
+}
+
+void store(std::vector<float> *lanes, int first, size_t i, const Vec3x4 &v)
+{
+    _mm_storeu_ps(&lanes[first][i], v.x.Data);
+    _mm_storeu_ps(&lanes[first + 1][i], v.y.Data);
+    _mm_storeu_ps(&lanes[first + 2][i], v.z.Data);
+}
+
+void store(std::vector<float> *lanes, int first, size_t i, const Quat4 &q)
+{
+    _mm_storeu_ps(&lanes[first][i], q.w.Data);
+    _mm_storeu_ps(&lanes[first + 1][i], q.x.Data);
+    _mm_storeu_ps(&lanes[first + 2][i], q.y.Data);
+    _mm_storeu_ps(&lanes[first + 3][i], q.z.Data);
+}
+
+void store(std::vector<float> *lanes, int first, size_t i, const Mat3x4 &m)
+{
+    for (int c = 0; c < 3; c++)
+        store(lanes, first + 3 * c, i, m.col[c]);
+}
+
+} // namespace
+#endif
+
+void TwoBoneBatch::solve()
+{
+    const size_t count = limbs_.size();
+    if (count == 0)
+        return;
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    // Pad to whole blocks with a straight limb along x that solves cleanly
+    static const float padding[NUM_LANES] = {
+        0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1,
+        1, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1,
+        2, 0, 0, 0, 1, 0,
+        1, 0, 0, 1,
+        1, 0, 0, 0, 1, 0, 0, 0
+    };
+    while (lanes_[0].size() % 4)
+        for (int l = 0; l < NUM_LANES; l++)
+            lanes_[l].push_back(padding[l]);
+
+    const glm::simdVec4 eps(TWO_BONE_EPSILON), eps2(TWO_BONE_EPSILON * TWO_BONE_EPSILON);
+    const glm::simdVec4 zero(0.f), one(1.f), two(2.f);
+    for (size_t i = 0; i < count; i += 4)
+    {
+        // Joint positions, as twoBoneJoints
+        const Vec3x4 root = load(lanes_, ROOT_X, i);
+        const Vec3x4 mid = load(lanes_, MID_X, i);
+        const Vec3x4 target = load(lanes_, TARGET_X, i);
+        const Vec3x4 pole = load(lanes_, POLE_X, i);
+        const Vec3x4 offset = load(lanes_, OFFSET_X, i);
+        const glm::simdVec4 upper = glm::niceSqrt(dot(offset, offset));
+        const glm::simdVec4 lower = load(lanes_[LOWER_LENGTH], i);
+
+        const Vec3x4 toTarget = target - root;
+        const glm::simdVec4 dist = glm::niceSqrt(dot(toTarget, toTarget));
+        const Vec3x4 dir = toTarget * (one / glm::max(dist, eps));
+        const glm::simdVec4 d = glm::min(glm::max(dist, glm::abs(upper - lower)), upper + lower);
+
+        const Vec3x4 toPole = pole - root, toMid = mid - root;
+        const Vec3x4 polebend = toPole - dir * dot(toPole, dir);
+        const Vec3x4 midbend = toMid - dir * dot(toMid, dir);
+        const __m128 usemid = _mm_cmplt_ps(dot(polebend, polebend).Data, eps2.Data);
+        Vec3x4 bend = select(usemid, midbend, polebend);
+        bend = bend * (one / glm::niceSqrt(glm::max(dot(bend, bend), eps2)));
+
+        const glm::simdVec4 cosangle = glm::clamp(
+                (upper * upper + d * d - lower * lower) / (two * upper * glm::max(d, eps)),
+                -1.f, 1.f);
+        const glm::simdVec4 sinangle = glm::niceSqrt(glm::max(zero, one - cosangle * cosangle));
+        const Vec3x4 solvedMid = root + dir * (upper * cosangle) + bend * (upper * sinangle);
+        const Vec3x4 solvedTip = root + dir * d;
+
+        // Turn the upper bone so the effector's offset points at the middle
+        // joint, then the effector so its length points at the tip, as
+        // alignChain.  Turning by r in a bone's own space turns its palette
+        // rotation by r as well.
+        const Mat3x4 upperBasis = loadMat(lanes_, UPPER_XX, i);
+        const Quat4 upperTurn = rotationBetween(offset, inverseRotate(upperBasis, solvedMid - root));
+        const Mat3x4 newUpper = upperBasis * toMat3(upperTurn);
+        const Vec3x4 lowerBase = root + newUpper * offset;
+
+        const Quat4 lowerRot = loadQuat(lanes_, LOWER_ROT_W, i);
+        const Mat3x4 lowerBasis = newUpper * toMat3(lowerRot);
+        const Quat4 lowerTurn = rotationBetween(Vec3x4(lower, zero, zero),
+                inverseRotate(lowerBasis, solvedTip - lowerBase));
+
+        store(lanes_, UPPER_XX, i, newUpper);
+        store(lanes_, LOWER_XX, i, lowerBasis * toMat3(lowerTurn));
+        store(lanes_, MID_X, i, lowerBase);
+        store(lanes_, UPPER_ROT_W, i, normalize(loadQuat(lanes_, UPPER_ROT_W, i) * upperTurn));
+        store(lanes_, LOWER_ROT_W, i, normalize(lowerRot * lowerTurn));
+    }
+
+    // Drop the padding so later adds line up with their limbs again
+    for (int l = 0; l < NUM_LANES; l++)
+        lanes_[l].resize(count);
+
+    for (size_t i = 0; i < count; i++)
+        writeBack(i);
+#else
+    for (size_t i = 0; i < count; i++)
+    {
+        const Limb &limb = limbs_[i];
+        solveTwoBone(*limb.rig, limb.pose, limb.palette, limb.effector,
+                glm::vec3(lanes_[TARGET_X][i], lanes_[TARGET_Y][i], lanes_[TARGET_Z][i]),
+                glm::vec3(lanes_[POLE_X][i], lanes_[POLE_Y][i], lanes_[POLE_Z][i]));
+    }
+#endif
+}
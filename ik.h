@@ -0,0 +1,109 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "rig.h"
+
+// Chain IK on a pose and its palette, as filled by Rig::computePalette.
+// The chain runs from root down the parent links to effector, whose tip is
+// pulled towards target, given in the same space as the palette.  Only
+// chain rotations change, lengths are kept.  The solvers keep the palette
+// in step as they go instead of recomputing it, and leave every palette
+// entry in root's subtree up to date when they return.
+
+// Longest chain the solvers handle, they keep the chain on the stack
+const int MAX_IK_CHAIN = 32;
+
+struct IKParams
+{
+    IKParams() : maxIterations(10), tolerance(1e-3f) {}
+
+    int maxIterations;
+    // Stop once the effector tip is this close to the target
+    float tolerance;
+};
+
+// Cyclic coordinate descent, each iteration turns every chain bone from the
+// effector back to root to point the effector at the target.  Returns the
+// final distance from the effector tip to the target.
+float solveCCD(const Rig &rig, BoneFrame *pose, glm::mat4 *palette,
+        int root, int effector, const glm::vec3 &target, const IKParams &params);
+
+// FABRIK, each iteration moves the joint positions back from the target
+// and forward from the fixed root, then turns the bones to match.  Out of
+// reach targets get a straight chain pointing at them.  Returns the final
+// distance from the effector tip to the target.
+float solveFABRIK(const Rig &rig, BoneFrame *pose, glm::mat4 *palette,
+        int root, int effector, const glm::vec3 &target, const IKParams &params);
+
+// Closed form IK for the two bone limb ending at effector, whose parent is
+// the upper bone.  The middle joint bends towards pole, which like target
+// is in palette space; a pole on the limb's line keeps the current bend.
+// Out of reach targets straighten the limb towards them.  Returns the
+// final distance from the effector tip to the target.
+float solveTwoBone(const Rig &rig, BoneFrame *pose, glm::mat4 *palette,
+        int effector, const glm::vec3 &target, const glm::vec3 &pole);
+
+// Two bone IK for many limbs at once, such as every foot in a crowd.  Limbs
+// are solved four at a time from SoA lanes: the joint positions, the turn
+// of both bones and their new palette entries.  Only bones hanging off the
+// limb are then refreshed one limb at a time.  Results match solveTwoBone
+// up to float rounding.  Storage is kept between frames, so once it has
+// grown to the largest batch, queueing and solving never allocate.
+class TwoBoneBatch
+{
+public:
+    TwoBoneBatch();
+
+    void clear();
+    size_t size() const { return limbs_.size(); }
+
+    // Queues a limb, pose and palette must stay valid and current until
+    // solve.  Limbs in the same pose must not share bones or hang off one
+    // another.
+    void add(const Rig &rig, BoneFrame *pose, glm::mat4 *palette,
+            int effector, const glm::vec3 &target, const glm::vec3 &pole);
+    // Solves every queued limb and writes the results back, the queue is
+    // kept until clear
+    void solve();
+
+private:
+    enum Lane
+    {
+        // upper bone's base and current palette rotation, in; rotation out
+        ROOT_X, ROOT_Y, ROOT_Z,
+        UPPER_XX, UPPER_XY, UPPER_XZ,
+        UPPER_YX, UPPER_YY, UPPER_YZ,
+        UPPER_ZX, UPPER_ZY, UPPER_ZZ,
+        // effector's base in, solved base out
+        MID_X, MID_Y, MID_Z,
+        // effector's palette rotation out
+        LOWER_XX, LOWER_XY, LOWER_XZ,
+        LOWER_YX, LOWER_YY, LOWER_YZ,
+        LOWER_ZX, LOWER_ZY, LOWER_ZZ,
+        TARGET_X, TARGET_Y, TARGET_Z,
+        POLE_X, POLE_Y, POLE_Z,
+        // effector's offset in the upper bone's space, and its length
+        OFFSET_X, OFFSET_Y, OFFSET_Z,
+        LOWER_LENGTH,
+        // bone rotations in, solved ones out
+        UPPER_ROT_W, UPPER_ROT_X, UPPER_ROT_Y, UPPER_ROT_Z,
+        LOWER_ROT_W, LOWER_ROT_X, LOWER_ROT_Y, LOWER_ROT_Z,
+        NUM_LANES
+    };
+
+    struct Limb
+    {
+        const Rig *rig;
+        BoneFrame *pose;
+        glm::mat4 *palette;
+        int effector;
+    };
+
+    std::vector<Limb> limbs_;
+    std::vector<float> lanes_[NUM_LANES];
+
+    void writeBack(size_t i);
+};
+
+// Shortest rotation taking direction from onto direction to
+glm::quat rotationBetween(const glm::vec3 &from, const glm::vec3 &to);
@@ -0,0 +1,188 @@
+#include "jobs.h"
+#include <unistd.h>
+#include <algorithm>
+
+// Set once by each worker, the calling thread keeps 0
+static __thread int currentThread = 0;
+
+JobSystem::JobSystem(int numThreads) :
+    queued_(0), pending_(0), quit_(false)
+{
+    if (numThreads <= 0)
+        numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (numThreads <= 0)
+        numThreads = 1;
+
+    pthread_mutex_init(&lock_, NULL);
+    pthread_cond_init(&wake_, NULL);
+    pthread_cond_init(&done_, NULL);
+
+    for (int i = 0; i < numThreads; i++)
+    {
+        Queue *q = new Queue();
+        pthread_mutex_init(&q->lock, NULL);
+        queues_.push_back(q);
+    }
+
+    // Queue 0 belongs to the thread calling parallelFor
+    workerArgs_.resize(numThreads);
+    threads_.resize(numThreads);
+    for (int i = 1; i < numThreads; i++)
+    {
+        workerArgs_[i].system = this;
+        workerArgs_[i].index = i;
+        pthread_create(&threads_[i], NULL, workerMain, &workerArgs_[i]);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    pthread_mutex_lock(&lock_);
+    quit_ = true;
+    pthread_cond_broadcast(&wake_);
+    pthread_mutex_unlock(&lock_);
+
+    for (size_t i = 1; i < threads_.size(); i++)
+        pthread_join(threads_[i], NULL);
+
+    for (size_t i = 0; i < queues_.size(); i++)
+    {
+        pthread_mutex_destroy(&queues_[i]->lock);
+        delete queues_[i];
+    }
+
+    pthread_cond_destroy(&done_);
+    pthread_cond_destroy(&wake_);
+    pthread_mutex_destroy(&lock_);
+}
+
+void JobSystem::parallelFor(size_t count, size_t grain, JobFunc func, void *data)
+{
+    if (count == 0)
+        return;
+    if (grain == 0)
+        grain = 1;
+
+    // Single threaded or a single chunk, skip the queues entirely
+    const size_t numJobs = (count + grain - 1) / grain;
+    if (queues_.size() == 1 || numJobs == 1)
+    {
+        func(data, 0, count);
+        return;
+    }
+
+    // Deal chunks out round robin so every thread starts with local work
+    const size_t numQueues = queues_.size();
+    for (size_t q = 0; q < numQueues; q++)
+    {
+        Queue *queue = queues_[q];
+        pthread_mutex_lock(&queue->lock);
+        for (size_t j = q; j < numJobs; j += numQueues)
+        {
+            Job job;
+            job.func = func;
+            job.data = data;
+            job.begin = j * grain;
+            job.end = std::min(count, job.begin + grain);
+            queue->jobs.push_back(job);
+        }
+        pthread_mutex_unlock(&queue->lock);
+    }
+
+    pthread_mutex_lock(&lock_);
+    __sync_fetch_and_add(&pending_, numJobs);
+    __sync_fetch_and_add(&queued_, numJobs);
+    pthread_cond_broadcast(&wake_);
+    pthread_mutex_unlock(&lock_);
+
+    // Help out until everything has finished
+    for (;;)
+    {
+        if (runOne(0))
+            continue;
+
+        pthread_mutex_lock(&lock_);
+        while (pending_ != 0 && queued_ == 0)
+            pthread_cond_wait(&done_, &lock_);
+        // Read with a barrier so every finished chunk's writes are visible,
+        // not only those of the thread that signalled done_
+        bool finished = __sync_fetch_and_add(&pending_, 0) == 0;
+        pthread_mutex_unlock(&lock_);
+
+        if (finished)
+            break;
+    }
+}
+
+int JobSystem::threadIndex()
+{
+    return currentThread;
+}
+
+bool JobSystem::runOne(int self)
+{
+    Job job;
+    bool found = false;
+
+    // Own queue first, newest job, then steal the oldest job of the others
+    const int numQueues = queues_.size();
+    for (int i = 0; i < numQueues && !found; i++)
+    {
+        Queue *queue = queues_[(self + i) % numQueues];
+        pthread_mutex_lock(&queue->lock);
+        if (!queue->jobs.empty())
+        {
+            if (i == 0)
+            {
+                job = queue->jobs.back();
+                queue->jobs.pop_back();
+            }
+            else
+            {
+                job = queue->jobs.front();
+                queue->jobs.pop_front();
+            }
+            found = true;
+        }
+        pthread_mutex_unlock(&queue->lock);
+    }
+
+    if (!found)
+        return false;
+
+    __sync_fetch_and_sub(&queued_, 1);
+    job.func(job.data, job.begin, job.end);
+
+    if (__sync_sub_and_fetch(&pending_, 1) == 0)
+    {
+        pthread_mutex_lock(&lock_);
+        pthread_cond_broadcast(&done_);
+        pthread_mutex_unlock(&lock_);
+    }
+
+    return true;
+}
+
+void *JobSystem::workerMain(void *args)
+{
+    WorkerArgs *wargs = static_cast<WorkerArgs *>(args);
+    JobSystem *system = wargs->system;
+    currentThread = wargs->index;
+
+    for (;;)
+    {
+        if (system->runOne(wargs->index))
+            continue;
+
+        pthread_mutex_lock(&system->lock_);
+        while (!system->quit_ && system->queued_ == 0)
+            pthread_cond_wait(&system->wake_, &system->lock_);
+        bool quit = system->quit_;
+        pthread_mutex_unlock(&system->lock_);
+
+        if (quit)
+            break;
+    }
+
+    return NULL;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <pthread.h>
+
+// Runs func(data, begin, end) on a sub range of the job's index range
+typedef void (*JobFunc)(void *data, size_t begin, size_t end);
+
+// Small work stealing thread pool.  Every thread, including the one calling
+// parallelFor, owns a queue of jobs.  Threads pop their own queue from the
+// back and steal from the front of the others when it runs dry.
+class JobSystem
+{
+public:
+    // numThreads counts the calling thread, 0 uses every online core
+    explicit JobSystem(int numThreads = 0);
+    ~JobSystem();
+
+    int numThreads() const { return queues_.size(); }
+    // Index in [0, numThreads()) of the thread running the current job, for
+    // per thread scratch.  0 on any thread that isn't a worker.
+    static int threadIndex();
+
+    // Splits [0, count) into chunks of at most grain indices and runs func
+    // over all of them.  Returns once every chunk has finished, so this is
+    // the join point.  Chunks must write disjoint outputs, then the result
+    // does not depend on which thread ran which chunk.
+    void parallelFor(size_t count, size_t grain, JobFunc func, void *data);
+
+private:
+    struct Job
+    {
+        JobFunc func;
+        void *data;
+        size_t begin, end;
+    };
+
+    struct Queue
+    {
+        pthread_mutex_t lock;
+        std::deque<Job> jobs;
+    };
+
+    struct WorkerArgs
+    {
+        JobSystem *system;
+        int index;
+    };
+
+    std::vector<Queue *> queues_;
+    std::vector<pthread_t> threads_;
+    std::vector<WorkerArgs> workerArgs_;
+
+    // Guards sleeping and waking, the counters are updated atomically
+    pthread_mutex_t lock_;
+    pthread_cond_t wake_;
+    pthread_cond_t done_;
+    // jobs sitting in a queue
+    volatile size_t queued_;
+    // jobs queued or running
+    volatile size_t pending_;
+    bool quit_;
+
+    bool runOne(int self);
+    static void *workerMain(void *args);
+
+    // Not copyable
+    JobSystem(const JobSystem &);
+    JobSystem &operator=(const JobSystem &);
+};
@@ -1,13 +1,16 @@
 #include "kiss-skeleton.h"
 #include <GL/glew.h>
+#include <cstddef>
 #include <iostream>
-#include <sstream>
-#include <fstream>
+#include <algorithm>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 const int Skeleton::ANGLE_MODE  = 1;
 const int Skeleton::LENGTH_MODE = 2;
+const int Skeleton::TWO_BONE_MODE = 3;
+const int Skeleton::CCD_SOLVER    = 1;
+const int Skeleton::FABRIK_SOLVER = 2;
 
 Skeleton::Skeleton() :
     renderer_(new SimpleBoneRenderer())
@@ -16,53 +19,88 @@ Skeleton::Skeleton() :
 
 Skeleton::~Skeleton()
 {
-    // Clean up bone pointers
-    std::map<std::string, Bone*>::iterator it;
-    for (it = bones_.begin(); it != bones_.end(); it++)
-        delete it->second;
 }
 
-void Skeleton::render(const glm::mat4 &transform) const
+const glm::mat4 *Skeleton::render(const glm::mat4 &transform, FrameArena *arena) const
 {
-    assert(bones_.size() > 0);
-    assert(bones_.find("root") != bones_.end());
+    assert(numBones() > 0);
 
-    renderBone(transform, bones_.find("root")->second);
+    std::vector<glm::mat4> heapPalette;
+    glm::mat4 *palette;
+    if (arena)
+        palette = arena->allocate<glm::mat4>(numBones());
+    else
+    {
+        heapPalette.resize(numBones());
+        palette = &heapPalette[0];
+    }
+    computePalette(transform, palette);
+
+    renderer_->add(rig_, &pose_[0], palette);
+    renderer_->flush();
+
+    return arena ? palette : NULL;
 }
 
-void Skeleton::dumpPose(std::ostream &os) const
+void Skeleton::computePalette(const glm::mat4 &root, glm::mat4 *out) const
 {
-    assert(bones_.find("root") != bones_.end());
-    printBoneFrame(bones_.find("root")->second, os);
+    rig_.computePalette(&pose_[0], root, out);
 }
 
-void Skeleton::setPose(const std::map<std::string, BoneFrame> &pose)
+void Skeleton::dumpPose(std::ostream &os) const
 {
-    std::map<std::string, BoneFrame>::const_iterator it;
-    for (it = pose.begin(); it != pose.end(); it++)
+    for (size_t i = 0; i < numBones(); i++)
     {
-        const std::string name = it->first;
-        const BoneFrame bframe = it->second;
+        const glm::vec4 rot = quatToAxisAngle(pose_[i].rot);
+        os  << rig_.getBoneName(i) << ' ' << pose_[i].length << ' '
+            << rot[0] << ' ' << rot[1] << ' ' << rot[2] << ' ' << rot[3] << '\n';
+    }
+}
 
-        assert(bones_.find(name) != bones_.end());
+void Skeleton::setPose(const std::vector<BoneFrame> &pose)
+{
+    assert(pose.size() == numBones());
 
-        Bone *bone = bones_[name];
-        bone->length = bframe.length;
-        bone->rot = bframe.rot;
+    for (size_t bone = 0; bone < pose.size(); bone++)
+    {
+        pose_[bone] = pose[bone];
+        invalidate(bone);
     }
 }
 
 void Skeleton::setBoneTipPosition(const std::string &bonename, const glm::vec3 &targetPos,
         int mode)
 {
-    assert(bones_.find(bonename) != bones_.end());
-    Bone *bone = bones_[bonename];
-
-    // First get the parent transform, we can't adjust that
-    glm::mat4 parentTransform = getFullBoneMatrix(bone->parent);
-    // Add to the parent transform the position of the current bone
-    parentTransform = glm::translate(parentTransform, glm::vec3(bone->pos));
-    glm::mat4 inverseParentTransform = glm::inverse(parentTransform);
+    int bone = rig_.getBoneIndex(bonename);
+    assert(bone >= 0);
+
+    if (mode == TWO_BONE_MODE)
+    {
+        // Solve on the world cache like solveIK, keeping the current bend
+        const int upper = rig_.getParent(bone);
+        if (upper < 0)
+            return;
+        const int end = rig_.getSubtreeEnd(upper);
+        for (int i = upper; i < end; i++)
+            getWorldMatrix(i);
+
+        solveTwoBone(rig_, &pose_[0], &world_[0], bone, targetPos,
+                glm::vec3(world_[bone][3]));
+        invalidate(upper);
+        return;
+    }
+
+    // First get the parent transform, we can't adjust that.  Move the cached
+    // parent transform to the position of the current bone.
+    const int parent = rig_.getParent(bone);
+    const glm::vec3 offset = rig_.getBoneOffset(&pose_[0], bone);
+    glm::mat4 parentTransform = glm::translate(glm::mat4(1.f), offset);
+    glm::mat4 inverseParentTransform = glm::translate(glm::mat4(1.f), -offset);
+    if (parent >= 0)
+    {
+        parentTransform = getWorldMatrix(parent) * parentTransform;
+        inverseParentTransform = inverseParentTransform * getWorldInverse(parent);
+    }
     //glm::mat4 curBoneTransform = glm::translate(glm::mat4(1.f), bone->pos);
     //curBoneTransform = glm::rotate(curBoneTransform, bone->rot.w, glm::vec3(bone->rot));
     //curBoneTransform = glm::translate(curBoneTransform, glm::vec3(bone->length, 0.f, 0.f));
@@ -71,18 +109,22 @@ void Skeleton::setBoneTipPosition(const std::string &bonename, const glm::vec3 &
     pt = inverseParentTransform * pt; pt /= pt.w;
 
 
-    glm::vec3 rotvec = glm::vec3(bone->rot);
-    float angle = bone->rot.w;
-    float length = bone->length;
+    glm::quat rot = pose_[bone].rot;
+    float length = pose_[bone].length;
     if (mode == ANGLE_MODE)
     {
-        // vector in direction of point of bone length (parent space)
-        glm::vec3 ptvec = glm::normalize(glm::vec3(pt)) * bone->length;
-
-        // Get the angle between untransformed and target vector (parent space)
-        angle = 180.f / M_PI * acos(glm::dot(glm::normalize(ptvec), glm::vec3(1, 0, 0)));
-        // Create an orthogonal vector to rotate around (parent space)
-        rotvec = glm::cross(glm::vec3(1, 0, 0), glm::normalize(ptvec));
+        // direction of the target point (parent space)
+        glm::vec3 ptdir = glm::normalize(glm::vec3(pt));
+
+        // Rotate the untransformed bone (x axis) onto the target direction.
+        // The quaternion (1 + cos, sin * axis) is the half angle rotation,
+        // so normalizing it needs no trig.
+        float cosangle = glm::dot(glm::vec3(1, 0, 0), ptdir);
+        if (cosangle < -0.9999f)
+            rot = glm::quat(0.f, 0.f, 0.f, 1.f);
+        else
+            rot = glm::normalize(glm::quat(1.f + cosangle,
+                        glm::cross(glm::vec3(1, 0, 0), ptdir)));
     }
     else if (mode == LENGTH_MODE)
     {
@@ -108,145 +150,98 @@ void Skeleton::setBoneTipPosition(const std::string &bonename, const glm::vec3 &
         assert(false && "unknown bone transform mode");
     }
 
-    bone->rot = glm::vec4(rotvec, angle);
-    bone->length = length;
+    pose_[bone].rot = rot;
+    pose_[bone].length = length;
+    invalidate(bone);
 }
 
-Keyframe Skeleton::getPose() const
+float Skeleton::solveIK(int root, int effector, const glm::vec3 &target, int solver,
+        const IKParams &params)
 {
-    Keyframe kf;
-
-    std::map<std::string, Bone*>::const_iterator it;
-    for (it = bones_.begin(); it != bones_.end(); it++)
-    {
-        const std::string &bname = it->first;
-        const Bone *bone = it->second;
-        BoneFrame bf;
-        bf.length = bone->length;
-        bf.rot = bone->rot;
-
-        kf.bones[bname] = bf;
-    }
+    // The solvers work straight on the world cache, bring it up to date
+    const int end = rig_.getSubtreeEnd(root);
+    for (int bone = root; bone < end; bone++)
+        getWorldMatrix(bone);
+
+    float dist = 0.f;
+    if (solver == CCD_SOLVER)
+        dist = solveCCD(rig_, &pose_[0], &world_[0], root, effector, target, params);
+    else if (solver == FABRIK_SOLVER)
+        dist = solveFABRIK(rig_, &pose_[0], &world_[0], root, effector, target, params);
+    else
+        assert(false && "unknown IK solver");
 
-    return kf;
+    // world_ is current again but the inverses aren't
+    invalidate(root);
+    return dist;
 }
 
-void Skeleton::resetPose()
+const glm::mat4 &Skeleton::getWorldMatrix(int bone) const
 {
-    setPose(refPose_.bones);
+    if (dirty_[bone])
+        updateWorld(bone);
+    return world_[bone];
 }
 
-void Skeleton::readBone(const std::string &bonestr)
+const glm::mat4 &Skeleton::getWorldInverse(int bone) const
 {
-    std::stringstream ss(bonestr);
-    std::string name, parentname;
-    float x, y, z, a, rotx, roty, rotz, length;
-    ss >> name >> x >> y >> z >> rotx >> roty >> rotz >> a >> length >> parentname;
-    if (!ss)
-    {
-        std::cerr << "Could not read bone from string: '" << bonestr << "'\n";
-        assert(false);
-    }
-
-    Bone *parent;
-    if (parentname == "NULL")
-    {
-        assert(name == "root");
-        parent = NULL;
-    }
-    else
-    {
-        assert(bones_.find(parentname) != bones_.end());
-        parent = bones_[parentname];
-    }
-
-    Bone *newbone = new Bone(name, length, glm::vec3(x, y, z), glm::vec4(rotx, roty, rotz, a), parent);
-    if (parent)
-        parent->children.push_back(newbone);
-    bones_[name] = newbone;
+    if (dirty_[bone])
+        updateWorld(bone);
+    return worldInverse_[bone];
 }
 
-void Skeleton::readSkeleton(const std::string &filename)
+void Skeleton::invalidate(int bone)
 {
-    std::ifstream file(filename.c_str());
-
-    std::string line;
-    while (std::getline(file, line))
-        readBone(line);
-
-    refPose_ = getPose();
+    // Already dirty means the whole subtree is already dirty
+    if (dirty_[bone])
+        return;
+    std::fill(dirty_.begin() + bone, dirty_.begin() + rig_.getSubtreeEnd(bone), 1);
 }
 
-void Skeleton::renderBone(const glm::mat4 &parentTransform, const Bone *bone) const
+void Skeleton::updateWorld(int bone) const
 {
-    if (!bone)
-        return;
-
-    glm::mat4 curTransform = glm::translate(parentTransform, bone->pos);
-    curTransform = glm::rotate(curTransform, bone->rot[3], glm::vec3(bone->rot));
-
-    // Don't render root bone!
-    if (bone->name != "root")
+    const int parent = rig_.getParent(bone);
+    if (parent >= 0 && dirty_[parent])
+        updateWorld(parent);
+
+    const glm::vec3 offset = rig_.getBoneOffset(&pose_[0], bone);
+    const glm::mat4 rotation = glm::mat4_cast(pose_[bone].rot);
+
+    // Rigid transform, so the inverse is just the transposed rotation
+    // followed by the negated translation
+    world_[bone] = glm::translate(glm::mat4(1.f), offset) * rotation;
+    worldInverse_[bone] = glm::transpose(rotation) * glm::translate(glm::mat4(1.f), -offset);
+    if (parent >= 0)
     {
-        // render the bone using the current renderer
-        (*renderer_)(curTransform, bone);
+        world_[bone] = world_[parent] * world_[bone];
+        worldInverse_[bone] = worldInverse_[bone] * worldInverse_[parent];
     }
 
-    // Move to the tip of the bone
-    curTransform = glm::translate(curTransform, glm::vec3(bone->length, 0.f, 0.f));
-
-    // Render children recursively
-    for (size_t i = 0; i < bone->children.size(); i++)
-        renderBone(curTransform, bone->children[i]);
+    dirty_[bone] = 0;
 }
 
-void Skeleton::printBone(const Bone *cur, std::ostream &os) const
+Keyframe Skeleton::getPose() const
 {
-    if (cur == NULL)
-        return;
-
-    os  << cur->name << ' ' << cur->pos[0] << ' ' << cur->pos[1] << ' ' << cur->pos[2] << ' '
-        << cur->rot[0] << ' ' << cur->rot[1] << ' ' << cur->rot[2] << ' ' << cur->rot[3] << ' '
-        << cur->length << ' ' << (cur->parent == NULL ? "NULL" : cur->parent->name) << '\n';
+    Keyframe kf;
+    kf.bones = pose_;
 
-    for (size_t i = 0; i < cur->children.size(); i++)
-        printBone(cur->children[i], os);
+    return kf;
 }
 
-void Skeleton::printBoneFrame(const Bone *cur, std::ostream &os) const
+void Skeleton::resetPose()
 {
-    if (cur == NULL)
-        return;
-
-    os  << cur->name << ' ' << cur->length << ' '
-        << cur->rot[0] << ' ' << cur->rot[1] << ' ' << cur->rot[2] << ' ' << cur->rot[3] << '\n';
-
-    for (size_t i = 0; i < cur->children.size(); i++)
-        printBoneFrame(cur->children[i], os);
+    setPose(rig_.getRefPose());
 }
 
-glm::mat4 Skeleton::getBoneMatrix(const Bone* bone) const
+bool Skeleton::readSkeleton(const std::string &filename)
 {
-    // null bone, identity transform
-    if (!bone) return glm::mat4(1.f);
-
-    // The transform for this bone
-    glm::mat4 transform = glm::translate(glm::mat4(1.f), bone->pos);
-    transform = glm::rotate(transform, bone->rot[3], glm::vec3(bone->rot));
-    transform = glm::translate(transform, glm::vec3(bone->length, 0.f, 0.f));
+    const bool ok = rig_.readRig(filename);
 
-    return transform;
-}
-
-glm::mat4 Skeleton::getFullBoneMatrix(const Bone* bone) const
-{
-    // base case, null bone, identity transform
-    if (!bone) return glm::mat4(1.f);
-
-    glm::mat4 transform = getBoneMatrix(bone);
-    glm::mat4 parentTransform = getFullBoneMatrix(bone->parent);
-
-    return parentTransform * transform;
+    pose_ = rig_.getRefPose();
+    world_.resize(numBones());
+    worldInverse_.resize(numBones());
+    dirty_.assign(numBones(), 1);
+    return ok;
 }
 
 void Skeleton::setBoneRenderer(BoneRenderer *br)
@@ -261,19 +256,48 @@ void Skeleton::setDefaultRenderer()
     renderer_ = new SimpleBoneRenderer();
 }
 
-void SimpleBoneRenderer::operator() (const glm::mat4 &transform, const Bone* bone)
+BoneRenderer::BoneRenderer() :
+    buffer_(0)
+{
+}
+
+BoneRenderer::~BoneRenderer()
+{
+    if (buffer_)
+        glDeleteBuffers(1, &buffer_);
+}
+
+void BoneRenderer::flush()
+{
+    if (batch_.size() == 0)
+        return;
+
+    if (!buffer_)
+        glGenBuffers(1, &buffer_);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer_);
+    // Orphan last frame's storage rather than wait for draws still using it
+    glBufferData(GL_ARRAY_BUFFER, batch_.size() * sizeof(BoneVertex), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, batch_.size() * sizeof(BoneVertex), batch_.data());
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(BoneVertex),
+            reinterpret_cast<const GLvoid *>(offsetof(BoneVertex, pos)));
+    glColorPointer(3, GL_FLOAT, sizeof(BoneVertex),
+            reinterpret_cast<const GLvoid *>(offsetof(BoneVertex, color)));
+
+    glDrawArrays(GL_LINES, 0, batch_.size());
+
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    batch_.clear();
+}
+
+void SimpleBoneRenderer::add(const Rig &rig, const BoneFrame *pose,
+        const glm::mat4 *palette)
 {
-    glPushMatrix();
-    
-    glMultMatrixf(glm::value_ptr(transform));
-
-    glBegin(GL_LINES);
-        glColor3f(0, 1, 0);
-        glVertex3f(0, 0, 0);
-        glColor3f(1, 0, 0);
-        glVertex3f(bone->length, 0, 0);
-    glEnd();
-
-    glPopMatrix();
+    batch_.add(palette, pose, rig.numBones());
 }
 
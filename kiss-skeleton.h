@@ -1,59 +1,46 @@
 #pragma once
 #include <string>
-#include <map>
 #include <vector>
 #include <glm/glm.hpp>
-
-
-struct Bone
+#include "rig.h"
+#include "animation.h"
+#include "arena.h"
+#include "ik.h"
+#include "bonebatch.h"
+
+// Draws skeletons from their palettes.  add appends a skeleton's bones to
+// one vertex stream and flush draws everything added since the last flush
+// with a single call, so any number of instances, such as a whole crowd,
+// cost one draw.  The stream is uploaded to a GL buffer object.
+class BoneRenderer
 {
-    std::string name;
-    float length;
-
-    glm::vec3 pos;
-    // x,y,z, angle
-    glm::vec4 rot;
-    
-    Bone *parent;
-    std::vector<Bone*> children;
-
-    Bone(const std::string &nm, float l,
-            const glm::vec3 &relpos, const glm::vec4 &relrot,
-            Bone *parnt) :
-        name(nm), length(l), pos(relpos), rot(relrot),
-        parent(parnt)
-    { }
-};
+public:
+    BoneRenderer();
+    virtual ~BoneRenderer();
 
-struct BoneFrame
-{
-    float length;
-    glm::vec4 rot;
-};
+    // The palette is in the space the bones are drawn in
+    virtual void add(const Rig &rig, const BoneFrame *pose,
+            const glm::mat4 *palette) = 0;
+    void flush();
 
-struct Keyframe
-{
-    int frame;
-    std::map<std::string, BoneFrame> bones;
-};
+protected:
+    BoneBatch batch_;
 
-struct Animation
-{
-    std::string name;
-    int numframes;
-    std::vector<Keyframe> keyframes;
-};
+private:
+    // Buffer object name, created on the first flush
+    unsigned int buffer_;
 
-// Callback functor for render each bone.
-// 
-struct BoneRenderer
-{
-    virtual void operator() (const glm::mat4 &transform, const Bone* b) = 0;
+    // Not copyable
+    BoneRenderer(const BoneRenderer &);
+    BoneRenderer &operator=(const BoneRenderer &);
 };
 
-struct SimpleBoneRenderer : public BoneRenderer
+// Bone lines only
+class SimpleBoneRenderer : public BoneRenderer
 {
-    virtual void operator() (const glm::mat4 &transform, const Bone* b);
+public:
+    virtual void add(const Rig &rig, const BoneFrame *pose,
+            const glm::mat4 *palette);
 };
 
 class Skeleton
@@ -62,14 +49,24 @@ public:
     Skeleton();
     ~Skeleton();
 
-    void render(const glm::mat4 &transform) const;
+    // The palette comes from arena when given, otherwise the heap.  Returns
+    // the arena palette so callers can reuse it until the arena is reset,
+    // NULL without an arena.
+    const glm::mat4 *render(const glm::mat4 &transform, FrameArena *arena = NULL) const;
+    // Fills out[0..numBones()) with the model space transform of each bone's
+    // base, every matrix is built from its parent's entry.  out may be
+    // indexed with the same bone indices as getPose/dumpPose order.
+    void computePalette(const glm::mat4 &root, glm::mat4 *out) const;
+    size_t numBones() const { return rig_.numBones(); }
     void dumpPose(std::ostream &os) const;
 
     void setBoneRenderer(BoneRenderer *renderer);
     void setDefaultRenderer();
 
-    void setPose(const std::map<std::string, BoneFrame> &pose);
-    void readSkeleton(const std::string &filename);
+    // pose holds one frame per bone, in bone index order
+    void setPose(const std::vector<BoneFrame> &pose);
+    // Returns false if the rig couldn't be read
+    bool readSkeleton(const std::string &filename);
 
 
     // Function used for editing
@@ -79,23 +76,43 @@ public:
     // Parameters to setBoneTipPosition mode type
     static const int ANGLE_MODE;
     static const int LENGTH_MODE;
+    // Moves the bone and its parent with two bone IK
+    static const int TWO_BONE_MODE;
+
+    // Turns the chain from root down to effector so the effector's tip
+    // reaches target, in model space.  Returns the remaining distance.
+    float solveIK(int root, int effector, const glm::vec3 &target, int solver,
+            const IKParams &params = IKParams());
+    // Parameters to solveIK solver type
+    static const int CCD_SOLVER;
+    static const int FABRIK_SOLVER;
 
     Keyframe getPose() const;
+    // The current pose without a copy, one frame per bone
+    const BoneFrame *getCurrentPose() const { return &pose_[0]; }
+
+    // The bone hierarchy, can be shared with crowd instances
+    const Rig &getRig() const { return rig_; }
 
+    // Cached model space transform of a bone's base and its inverse.  Only
+    // the entries invalidated by a pose change since the last call are
+    // recomputed, each from its parent's cached entry.
+    const glm::mat4 &getWorldMatrix(int bone) const;
+    const glm::mat4 &getWorldInverse(int bone) const;
 
 private:
-    std::map<std::string, Bone *> bones_;
+    Rig rig_;
+    // Current pose, one frame per bone
+    std::vector<BoneFrame> pose_;
 
-    void renderBone(const glm::mat4 &parentTransform, const Bone *bone) const;
-    void readBone(const std::string &bonestr);
-    void printBone(const Bone *bone, std::ostream &os) const;
-    void printBoneFrame(const Bone *cur, std::ostream &os) const;
-    glm::mat4 getBoneMatrix(const Bone* bone) const;
-    glm::mat4 getFullBoneMatrix(const Bone* bone) const;
+    // World transform cache, a dirty bone always has dirty descendants
+    mutable std::vector<glm::mat4> world_;
+    mutable std::vector<glm::mat4> worldInverse_;
+    mutable std::vector<char> dirty_;
 
-    BoneRenderer *renderer_;
+    void invalidate(int bone);
+    void updateWorld(int bone) const;
 
-    // Original, reference pose, stored when read in from file
-    Keyframe refPose_;
+    BoneRenderer *renderer_;
 };
 
@@ -5,28 +5,25 @@
 #include <sstream>
 #include <fstream>
 #include <vector>
-#include <map>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
 #include "uistate.h"
 #include "kiss-skeleton.h"
+#include "animation.h"
+#include "clipfile.h"
+#include "spline.h"
+#include "blend.h"
+#include "pick.h"
 
+// Bone lines with tip markers, the selected bone's highlighted
 struct EditBoneRenderer : public BoneRenderer
 {
-    virtual void operator() (const glm::mat4 &transform, const Bone *bone);
+    virtual void add(const Rig &rig, const BoneFrame *pose,
+            const glm::mat4 *palette);
 
-    std::map<std::string, glm::vec3> boneNDC;
     std::string selectedBone;
 };
 
-void printBone(Bone *skeleton);
-void dumpKeyframe(const Keyframe &kf);
-void dumpAnimation(const Animation &anim);
-Animation readAnimation(const std::string &filename);
-Keyframe getPose(const Animation &anim, int frame);
-void renderCube();
-
 int windowWidth = 800, windowHeight = 600;
 
 EditBoneRenderer *ebrenderer = NULL;
@@ -35,10 +32,25 @@ int editMode;
 
 std::fstream posefile;
 
-glm::mat4 viewMatrix(1.f);
+// Bone tips of the last edit mode frame, for picking
+BonePicker bonepicker;
 
 Skeleton *skeleton;
 Animation curanim;
+AnimCursor animcursor;
+// Reused every redraw so playback doesn't allocate
+std::vector<BoneFrame> animpose;
+// Spline playback of curanim, rebuilt whenever its keys change
+bool splineplayback = false;
+SplineClip curspline;
+// Optional second clip blended over curanim, or layered on top of it when
+// additive, weight set with [ and ]
+Animation blendanim;
+AnimCursor blendcursor;
+std::vector<BoneFrame> blendpose;
+float blendweight = 0.5f;
+// Scratch memory for one redraw
+FrameArena framearena;
 int framenum = 0;
 
 // Peter's mystical ui controller for arcball transformation and stuff
@@ -47,25 +59,46 @@ static UIState *ui;
 void redraw(void)
 {
     //std::cout << "Edit mode: " << editMode << '\n';
+    framearena.reset();
+
     // Now render
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    // Apply the camera transformation.
-    ui->ApplyViewingTransformation();
-
-    glGetFloatv(GL_MODELVIEW_MATRIX, glm::value_ptr(viewMatrix));
+    // The camera transformation is passed to the bones as their root
+    ui->UpdateViewMatrix();
+    const glm::mat4 &viewMatrix = ui->ViewMatrix();
 
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
 
     // Set the bone pose
-    if (!ebrenderer)
+    if (!ebrenderer && !curanim.keyframes.empty())
     {
-        Keyframe kf = getPose(curanim, framenum);
-        skeleton->setPose(kf.bones);
+        animpose.resize(skeleton->numBones());
+        if (splineplayback)
+            curspline.samplePose(framenum, &animpose[0], &animcursor);
+        else
+            samplePose(curanim, framenum, &animpose[0], &animcursor);
+
+        if (!blendanim.keyframes.empty())
+        {
+            blendpose.resize(skeleton->numBones());
+            samplePose(blendanim, framenum, &blendpose[0], &blendcursor);
+            if (blendanim.additive)
+                applyAdditive(&animpose[0], &blendpose[0], animpose.size(), blendweight,
+                        NULL, &animpose[0]);
+            else
+                blendPoses(&animpose[0], &blendpose[0], animpose.size(), blendweight,
+                        NULL, &animpose[0]);
+        }
+        skeleton->setPose(animpose);
     }
 
-    skeleton->render(viewMatrix);
+    const glm::mat4 *palette = skeleton->render(viewMatrix, &framearena);
+
+    if (ebrenderer)
+        bonepicker.build(ui->ProjectionMatrix(), palette, skeleton->getCurrentPose(),
+                skeleton->numBones());
 
     glutSwapBuffers();
 }
@@ -99,17 +132,9 @@ glm::vec2 getNDC(int x, int y)
     return screen_pos;
 }
 
-glm::mat4 getProjectionMatrix()
-{
-    glm::mat4 pmat;
-    glGetFloatv(GL_PROJECTION_MATRIX, glm::value_ptr(pmat));
-
-    return pmat;
-}
-
 glm::mat4 getModelViewProjectionMatrix()
 {
-    return getProjectionMatrix() * viewMatrix;
+    return ui->ProjectionMatrix() * ui->ViewMatrix();
 }
 
 void mouse(int button, int state, int x, int y)
@@ -122,26 +147,12 @@ void mouse(int button, int state, int x, int y)
             glm::vec2 screen_pos = getNDC(x, y);
             //std::cout << "Click screen pos: " << screen_pos.x << ' ' << screen_pos.y << '\n';
 
-            //std::cout << "bone ndc size: " << ebrenderer->boneNDC.size() << '\n';
-            std::map<std::string, glm::vec3>::const_iterator it;
-            float closestZ = HUGE_VAL;
-            for (it = ebrenderer->boneNDC.begin(); it != ebrenderer->boneNDC.end(); it++)
+            const float select_dist = 0.01f;
+            int bone = bonepicker.pick(screen_pos, select_dist);
+            if (bone >= 0)
             {
-                std::string name = it->first;
-                glm::vec3 bonepos = it->second;
-
-                const float select_dist = 0.01f;
-
-                float dist = glm::length(glm::vec2(bonepos) - screen_pos);
-
-                //std::cout << name << " bone ndc coord: " << bonepos.x << ' ' << bonepos.y << '\n';
-
-                if (dist < select_dist && bonepos.z < closestZ)
-                {
-                    ebrenderer->selectedBone = name;
-                    closestZ = bonepos.z;
-                    selectedBonePos = bonepos;
-                }
+                ebrenderer->selectedBone = skeleton->getRig().getBoneName(bone);
+                selectedBonePos = bonepicker.getTipNDC(bone);
             }
         }
         if (state == GLUT_UP)
@@ -195,7 +206,7 @@ void keyboard(GLubyte key, GLint x, GLint y)
         posefile << posename << '\n';
         skeleton->dumpPose(posefile);
         posefile << "\n";
-        //dumpAnimation(curanim);
+        //dumpAnimation(curanim, skeleton->getRig());
     }
     if (key == '+')
     {
@@ -231,17 +242,43 @@ void keyboard(GLubyte key, GLint x, GLint y)
         editMode = Skeleton::LENGTH_MODE;
     if (key == 'a')
         editMode = Skeleton::ANGLE_MODE;
+    if (key == 't')
+        editMode = Skeleton::TWO_BONE_MODE;
 
     if (key == 'p')
     {
         Keyframe kf = skeleton->getPose();
         kf.frame = framenum;
 
-        curanim.keyframes.push_back(kf);
+        // Keep keys sorted by frame, replacing any key already at framenum
+        std::vector<Keyframe>::iterator it = curanim.keyframes.begin();
+        while (it != curanim.keyframes.end() && it->frame < framenum)
+            ++it;
+        if (it != curanim.keyframes.end() && it->frame == framenum)
+            *it = kf;
+        else
+            curanim.keyframes.insert(it, kf);
         curanim.numframes = std::max(curanim.numframes, framenum);
+        if (splineplayback)
+            curspline.build(curanim);
         std::cout << "pushed a keyframe @ " << framenum << '\n';
     }
 
+    if (key == 's')
+    {
+        splineplayback = !splineplayback;
+        if (splineplayback && !curanim.keyframes.empty())
+            curspline.build(curanim);
+        std::cout << "spline playback: " << (splineplayback ? "on" : "off") << '\n';
+    }
+
+    if (key == '[' || key == ']')
+    {
+        blendweight += key == ']' ? 0.1f : -0.1f;
+        blendweight = glm::clamp(blendweight, 0.f, 1.f);
+        std::cout << "blend weight: " << blendweight << '\n';
+    }
+
     if (key == 'r')
     {
         skeleton->resetPose();
@@ -251,6 +288,18 @@ void keyboard(GLubyte key, GLint x, GLint y)
     glutPostRedisplay();
 }
 
+Animation loadAnimation(const std::string &filename, const Rig &rig)
+{
+    // Binary clips are copied into an Animation so they can be edited
+    ClipFile clip;
+    if (hasClipExtension(filename) && clip.open(filename))
+    {
+        clip.bind(rig);
+        return clip.toAnimation();
+    }
+    return readAnimation(filename, rig);
+}
+
 void cleanup()
 {
     posefile.close();
@@ -261,12 +310,6 @@ int main(int argc, char **argv)
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH | GLUT_MULTISAMPLE);
 
-    if (argc == 2)
-    {
-        std::cout << "Reading animation from " << argv[1] << '\n';
-        curanim = readAnimation(argv[1]);
-    }
-
     glutCreateWindow("kiss_particle demo");
     glutDisplayFunc(redraw);
     glutReshapeFunc(reshape);
@@ -296,9 +339,21 @@ int main(int argc, char **argv)
 
     std::string bonefile = "test.bones";
     skeleton = new Skeleton();
-    skeleton->readSkeleton(bonefile);
+    if (!skeleton->readSkeleton(bonefile))
+        exit(1);
     editMode = Skeleton::ANGLE_MODE;
 
+    if (argc >= 2)
+    {
+        std::cout << "Reading animation from " << argv[1] << '\n';
+        curanim = loadAnimation(argv[1], skeleton->getRig());
+    }
+    if (argc >= 3)
+    {
+        std::cout << "Blending animation from " << argv[2] << '\n';
+        blendanim = loadAnimation(argv[2], skeleton->getRig());
+    }
+
     posefile.open("charlie.poses", std::fstream::app | std::fstream::out);
 
     atexit(cleanup);
@@ -311,222 +366,8 @@ int main(int argc, char **argv)
     return 0;             /* ANSI C requires main to return int. */
 }
 
-BoneFrame readBoneFrame(std::istream &is)
-{
-    BoneFrame bf;
-    is >> bf.length >> bf.rot.x >> bf.rot.y >> bf.rot.z >> bf.rot[3];
-    if (!is)
-    {
-        std::cerr << "Unable to read BoneFrame\n";
-        exit(1);
-    }
-
-    return bf;
-}
-
-Animation readAnimation(const std::string &filename)
-{
-    Animation anim;
-    Keyframe keyframe;
-    
-    std::ifstream file(filename.c_str());
-    if (!file)
-    {
-        std::cerr << "Unable to open animation file: " << filename << '\n';
-        exit(1);
-    }
-
-    file >> anim.name >> anim.numframes;
-    if (!file)
-    {
-        std::cerr << "Unable to read header from animation file: " << filename << '\n';
-        exit(1);
-    }
-
-    std::string line;
-    keyframe.frame = -1;
-    while (std::getline(file, line))
-    {
-        if (line.empty())
-            continue;
-
-        std::stringstream ss(line);
-        std::string name;
-        ss >> name;
-        if (name == "KEYFRAME")
-        {
-            int num;
-            ss >> num;
-            if (!ss)
-            {
-                std::cerr << "Unable to read keyframe line: " << line << '\n';
-                exit(1);
-            }
-
-            if (keyframe.frame >= 0)
-                anim.keyframes.push_back(keyframe);
-            keyframe = Keyframe();
-            keyframe.frame = num;
-        }
-        else
-        {
-            BoneFrame bf = readBoneFrame(ss);
-            keyframe.bones[name] = bf;
-        }
-    }
-
-    anim.keyframes.push_back(keyframe);
-
-    return anim;
-}
-
-glm::vec4 getquat(const glm::vec4 &rot)
-{
-    float rad = rot[3] * M_PI / 180.f / 2.f;
-
-    return glm::vec4(cosf(rad),
-            rot[0] * sinf(rad),
-            rot[1] * sinf(rad),
-            rot[2] * sinf(rad));
-}
-
-
-Keyframe interpolate(const Keyframe &a, const Keyframe &b, int fnum)
+void EditBoneRenderer::add(const Rig &rig, const BoneFrame *pose,
+        const glm::mat4 *palette)
 {
-    Keyframe ret;
-    ret.frame = fnum;
-
-    assert(a.frame <= fnum && b.frame >= fnum);
-
-    std::map<std::string, BoneFrame>::const_iterator it;
-    for (it = a.bones.begin(); it != a.bones.end(); it++)
-    {
-        const std::string &name = it->first;
-        assert(b.bones.find(name) != b.bones.end());
-
-        const BoneFrame &af = it->second;
-        const BoneFrame &bf = b.bones.find(name)->second;
-
-        float fact = static_cast<float>(fnum - a.frame) / (b.frame - a.frame);
-
-        glm::vec4 aquat = getquat(af.rot);
-        glm::vec4 bquat = getquat(bf.rot);
-
-        glm::vec4 interquat = fact * bquat + (1 - fact) * aquat;
-        interquat /= glm::length(interquat);
-        glm::vec4 interrot = glm::vec4(interquat[1], interquat[2], interquat[3],
-                2*acos(interquat[0]) / M_PI * 180.f);
-
-        float interlength = fact * bf.length + (1 - fact) * af.length;
-
-
-        BoneFrame cf;
-        cf.rot = interrot;
-        cf.length = interlength;
-        ret.bones[name] = cf;
-    }
-
-    return ret;
+    batch_.add(palette, pose, rig.numBones(), true, rig.getBoneIndex(selectedBone));
 }
-
-Keyframe getPose(const Animation &anim, int frame)
-{
-    // safety check
-    if (anim.keyframes.empty())
-        return Keyframe();
-    // Just stick on the last frame, no repeat for now
-    if (frame >= anim.numframes)
-        return anim.keyframes.back();
-
-    // Find the frames to interpolate
-    size_t i;
-    for (i = 1; i < anim.keyframes.size(); i++)
-    {
-        if (anim.keyframes[i].frame > frame)
-            break;
-    }
-    assert(i < anim.keyframes.size());
-
-    Keyframe kf = interpolate(anim.keyframes[i - 1], anim.keyframes[i], frame);
-    
-    return kf;
-}
-
-void dumpAnimation(const Animation &anim)
-{
-    // print header
-    std::cout << "outputted_anim\n" << anim.numframes << "\n\n";
-
-    for (size_t i = 0; i < anim.keyframes.size(); i++)
-    {
-        dumpKeyframe(anim.keyframes[i]);
-        std::cout << '\n';
-    }
-}
-
-void dumpKeyframe(const Keyframe &kf)
-{
-    std::map<std::string, BoneFrame>::const_iterator it;
-    std::cout << "KEYFRAME " << kf.frame << '\n';
-    for (it = kf.bones.begin(); it != kf.bones.end(); it++)
-    {
-        const BoneFrame &bf = it->second;
-        std::cout << it->first << ' ' << bf.length << ' '
-            << bf.rot.x << ' ' << bf.rot.y << ' ' << bf.rot.z << ' ' << bf.rot.w << '\n';
-    }
-}
-
-GLfloat vertices[] = {
-    1,1,1,  -1,1,1,  -1,-1,1,  1,-1,1,        // v0-v1-v2-v3
-    1,1,1,  1,-1,1,  1,-1,-1,  1,1,-1,        // v0-v3-v4-v5
-    1,1,1,  1,1,-1,  -1,1,-1,  -1,1,1,        // v0-v5-v6-v1
-    -1,1,1,  -1,1,-1,  -1,-1,-1,  -1,-1,1,    // v1-v6-v7-v2
-    -1,-1,-1,  1,-1,-1,  1,-1,1,  -1,-1,1,    // v7-v4-v3-v2
-    1,-1,-1,  -1,-1,-1,  -1,1,-1,  1,1,-1};   // v4-v7-v6-v5
-
-
-void renderCube()
-{
-    glEnableClientState(GL_VERTEX_ARRAY);
-    glVertexPointer(3, GL_FLOAT, 0, vertices);
-
-    glDrawArrays(GL_QUADS, 0, 24);
-
-    glDisableClientState(GL_VERTEX_ARRAY);
-}
-
-void EditBoneRenderer::operator() (const glm::mat4 &transform, const Bone *bone)
-{
-    glPushMatrix();
-    glMultMatrixf(glm::value_ptr(transform));
-
-    glBegin(GL_LINES);
-        glColor3f(0, 1, 0);
-        glVertex3f(0, 0, 0);
-        glColor3f(1, 0, 0);
-        glVertex3f(bone->length, 0, 0);
-    glEnd();
-
-    float cube_scale = bone->length / 10.f;
-    if (bone->name == selectedBone)
-        glColor3f(0.2, 0.2, 0.8);
-    else
-        glColor3f(0.5, 0.5, 0.5);
-
-    // Record the ndc coords of the bone tip
-    glm::vec4 ndc_coord(bone->length, 0.f, 0.f, 1.f);
-    ndc_coord = getProjectionMatrix() * transform * ndc_coord;
-    ndc_coord /= ndc_coord.w;
-    boneNDC[bone->name] = glm::vec3(ndc_coord);
-
-    // Render cube at tip
-    // TODO make a helper that takes a transform to do this
-    glPushMatrix();
-    glTranslatef(bone->length, 0, 0);
-    glScalef(cube_scale, cube_scale, cube_scale);
-    renderCube();
-    glPopMatrix();
-
-    glPopMatrix();
-}
-
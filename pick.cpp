@@ -0,0 +1,84 @@
+#include "pick.h"
+#include <algorithm>
+#include <cmath>
+
+BonePicker::BonePicker(int gridSize) :
+    gridSize_(gridSize),
+    cellStart_(gridSize * gridSize + 1, 0)
+{
+}
+
+int BonePicker::cellCoord(float ndc) const
+{
+    int c = static_cast<int>((ndc + 1.f) * 0.5f * gridSize_);
+    return std::min(std::max(c, 0), gridSize_ - 1);
+}
+
+void BonePicker::build(const glm::mat4 &viewProj, const glm::mat4 *palette,
+        const BoneFrame *pose, size_t numBones)
+{
+    tips_.resize(numBones);
+    boneCell_.resize(numBones);
+    std::fill(cellStart_.begin(), cellStart_.end(), 0);
+
+    // Count the tips in each cell, offset by one for the prefix sum
+    size_t numIndexed = 0;
+    for (size_t i = 0; i < numBones; i++)
+    {
+        glm::vec4 clip = viewProj * palette[i] * glm::vec4(pose[i].length, 0.f, 0.f, 1.f);
+        boneCell_[i] = -1;
+        if (clip.w <= 0.f)
+        {
+            tips_[i] = glm::vec3(0.f, 0.f, HUGE_VAL);
+            continue;
+        }
+        tips_[i] = glm::vec3(clip) / clip.w;
+
+        const glm::vec3 &tip = tips_[i];
+        if (i == 0 || glm::abs(tip.x) > 1.f || glm::abs(tip.y) > 1.f)
+            continue;
+        boneCell_[i] = cellCoord(tip.y) * gridSize_ + cellCoord(tip.x);
+        cellStart_[boneCell_[i] + 1]++;
+        numIndexed++;
+    }
+
+    for (size_t c = 1; c < cellStart_.size(); c++)
+        cellStart_[c] += cellStart_[c - 1];
+
+    // Scatter each bone into its cell, keeping bone order within a cell
+    cellBones_.resize(numIndexed);
+    for (size_t i = 0; i < numBones; i++)
+        if (boneCell_[i] >= 0)
+            cellBones_[cellStart_[boneCell_[i]]++] = i;
+    // The scatter advanced each start to the next cell's, shift them back
+    for (size_t c = cellStart_.size() - 1; c > 0; c--)
+        cellStart_[c] = cellStart_[c - 1];
+    cellStart_[0] = 0;
+}
+
+int BonePicker::pick(const glm::vec2 &ndc, float radius) const
+{
+    int x0 = cellCoord(ndc.x - radius), x1 = cellCoord(ndc.x + radius);
+    int y0 = cellCoord(ndc.y - radius), y1 = cellCoord(ndc.y + radius);
+
+    int closest = -1;
+    float closestZ = HUGE_VAL;
+    for (int y = y0; y <= y1; y++)
+        for (int x = x0; x <= x1; x++)
+        {
+            int cell = y * gridSize_ + x;
+            for (int j = cellStart_[cell]; j < cellStart_[cell + 1]; j++)
+            {
+                int bone = cellBones_[j];
+                const glm::vec3 &tip = tips_[bone];
+                float dist = glm::length(glm::vec2(tip) - ndc);
+                if (dist < radius && tip.z < closestZ)
+                {
+                    closest = bone;
+                    closestZ = tip.z;
+                }
+            }
+        }
+
+    return closest;
+}
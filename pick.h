@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "rig.h"
+
+// Mouse picking of bone tips in normalized device coordinates.  build()
+// projects every tip from the palette on the CPU and buckets it into a
+// uniform screen space grid, so a pick only looks at the few cells around
+// the click instead of every bone.  Nothing is read back from GL.
+class BonePicker
+{
+public:
+    // The grid covers [-1, 1] on both axes with gridSize cells per side
+    explicit BonePicker(int gridSize = 64);
+
+    // Tip of bone i is palette[i] * (pose[i].length, 0, 0, 1), projected by
+    // viewProj.  Bone 0, the root, is never drawn and is never picked, nor
+    // are tips outside the view.  Storage is kept between builds.
+    void build(const glm::mat4 &viewProj, const glm::mat4 *palette,
+            const BoneFrame *pose, size_t numBones);
+
+    // Returns the bone whose tip is nearest the viewer among those within
+    // radius of ndc, or -1 if there is none.
+    int pick(const glm::vec2 &ndc, float radius) const;
+
+    // Projected tip of a bone from the last build, z is NDC depth
+    const glm::vec3 &getTipNDC(int bone) const { return tips_[bone]; }
+
+private:
+    int gridSize_;
+    std::vector<glm::vec3> tips_;
+    // Cell of each bone's tip, -1 when it isn't indexed
+    std::vector<int> boneCell_;
+    // Bones in cell c are cellBones_[cellStart_[c], cellStart_[c + 1])
+    std::vector<int> cellStart_;
+    std::vector<int> cellBones_;
+
+    int cellCoord(float ndc) const;
+};
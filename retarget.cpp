@@ -0,0 +1,70 @@
+#include "retarget.h"
+#include <cmath>
+
+RetargetMap::RetargetMap() :
+    numSourceBones_(0)
+{
+}
+
+void RetargetMap::build(const Rig &source, const Rig &target,
+        const std::map<std::string, std::string> *names)
+{
+    const std::vector<BoneFrame> &sourceRef = source.getRefPose();
+    const std::vector<BoneFrame> &targetRef = target.getRefPose();
+
+    numSourceBones_ = source.numBones();
+    bones_.resize(target.numBones());
+
+    for (size_t i = 0; i < bones_.size(); i++)
+    {
+        const std::string &name = target.getBoneName(i);
+        std::map<std::string, std::string>::const_iterator it;
+        if (names && (it = names->find(name)) != names->end())
+            bones_[i].source = source.getBoneIndex(it->second);
+        else
+            bones_[i].source = source.getBoneIndex(name);
+
+        BoneMap &bm = bones_[i];
+        const BoneFrame &tref = targetRef[i];
+        if (bm.source < 0)
+        {
+            // Unmapped bones are driven by nothing, hold the reference pose
+            bm.rotOffset = tref.rot;
+            bm.lengthScale = 0.f;
+            bm.lengthOffset = tref.length;
+            continue;
+        }
+
+        const BoneFrame &sref = sourceRef[bm.source];
+        bm.rotOffset = glm::normalize(tref.rot * glm::conjugate(sref.rot));
+        // A zero length source bone can't be scaled, use the target's length
+        if (fabsf(sref.length) > 1e-6f)
+        {
+            bm.lengthScale = tref.length / sref.length;
+            bm.lengthOffset = 0.f;
+        }
+        else
+        {
+            bm.lengthScale = 0.f;
+            bm.lengthOffset = tref.length;
+        }
+    }
+}
+
+void RetargetMap::apply(const BoneFrame *source, BoneFrame *out) const
+{
+    for (size_t i = 0; i < bones_.size(); i++)
+    {
+        const BoneMap &bm = bones_[i];
+        if (bm.source < 0)
+        {
+            out[i].rot = bm.rotOffset;
+            out[i].length = bm.lengthOffset;
+            continue;
+        }
+
+        const BoneFrame &src = source[bm.source];
+        out[i].rot = bm.rotOffset * src.rot;
+        out[i].length = src.length * bm.lengthScale + bm.lengthOffset;
+    }
+}
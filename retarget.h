@@ -0,0 +1,44 @@
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include "rig.h"
+
+// Correction table for playing poses authored on one rig on another.
+// Built once per rig pair, applying it is a quaternion multiply and a
+// multiply add per bone.  A target bone takes its source bone's rotation
+// relative to the source reference pose on top of its own reference pose,
+// and its source length scaled by the ratio of the reference lengths.
+// Target bones with no source bone hold their reference pose.
+class RetargetMap
+{
+public:
+    RetargetMap();
+
+    // Bones are matched by name.  names, if given, maps target bone names
+    // to source bone names for bones that are named differently.
+    void build(const Rig &source, const Rig &target,
+            const std::map<std::string, std::string> *names = NULL);
+
+    size_t numSourceBones() const { return numSourceBones_; }
+    size_t numTargetBones() const { return bones_.size(); }
+    // Source bone driving target bone, -1 for none
+    int getSourceBone(int target) const { return bones_[target].source; }
+
+    // source holds numSourceBones() frames, out numTargetBones()
+    void apply(const BoneFrame *source, BoneFrame *out) const;
+
+private:
+    struct BoneMap
+    {
+        int source;
+        // target ref * conjugate(source ref), or the target ref rotation
+        // when unmapped
+        glm::quat rotOffset;
+        float lengthScale;
+        float lengthOffset;
+    };
+
+    size_t numSourceBones_;
+    std::vector<BoneMap> bones_;
+};
@@ -0,0 +1,390 @@
+#include "rig.h"
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+// Binary rig format, native endian, every field 4 byte aligned:
+//   RigFileHeader
+//   int32   parents[numBones]
+//   int32   subtreeEnd[numBones]
+//   uint32  nameOffsets[numBones]   into the string table
+//   float   positions[numBones][3]
+//   float   lengths[numBones]       reference pose
+//   float   rotations[numBones][4]  reference pose, x,y,z,w
+//   char    strings[stringTableSize] NUL terminated names
+// Bones are stored in the final depth first order, so loading is a handful
+// of bulk copies with no parsing or sorting.
+static const char RIG_MAGIC[4] = { 'K', 'S', 'R', 'G' };
+static const uint32_t RIG_VERSION = 1;
+
+struct RigFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t numBones;
+    uint32_t stringTableSize;
+};
+
+static size_t rigFileSize(uint32_t numBones, uint32_t stringTableSize)
+{
+    return sizeof(RigFileHeader) + numBones * (3 * sizeof(int32_t) + 8 * sizeof(float))
+        + stringTableSize;
+}
+
+bool Rig::readRig(const std::string &filename)
+{
+    clear();
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "Unable to open rig file: " << filename << '\n';
+        return false;
+    }
+
+    struct stat st;
+    fstat(fd, &st);
+    const size_t size = st.st_size;
+
+    // Binary rigs are used straight out of the mapping
+    void *data = MAP_FAILED;
+    if (size >= sizeof(RigFileHeader))
+        data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    bool ok = true;
+    if (data != MAP_FAILED && memcmp(data, RIG_MAGIC, sizeof(RIG_MAGIC)) == 0)
+        ok = readBinaryRig(static_cast<const char *>(data), size, filename);
+    else
+        readTextRig(filename);
+
+    if (data != MAP_FAILED)
+        munmap(data, size);
+
+    if (!ok)
+        clear();
+    return ok && numBones() > 0;
+}
+
+void Rig::clear()
+{
+    names_.clear();
+    parents_.clear();
+    positions_.clear();
+    subtreeEnd_.clear();
+    refPose_.clear();
+    boneIndex_.clear();
+}
+
+bool Rig::writeRig(const std::string &filename) const
+{
+    const uint32_t numBones = names_.size();
+
+    std::vector<uint32_t> nameOffsets(numBones);
+    std::string strings;
+    for (size_t i = 0; i < numBones; i++)
+    {
+        nameOffsets[i] = strings.size();
+        strings += names_[i];
+        strings += '\0';
+    }
+    // Pad so the file size stays 4 byte aligned
+    while (strings.size() % 4)
+        strings += '\0';
+
+    std::vector<float> lengths(numBones);
+    std::vector<glm::vec4> rotations(numBones);
+    for (size_t i = 0; i < numBones; i++)
+    {
+        const glm::quat &q = refPose_[i].rot;
+        lengths[i] = refPose_[i].length;
+        rotations[i] = glm::vec4(q.x, q.y, q.z, q.w);
+    }
+
+    RigFileHeader header;
+    memcpy(header.magic, RIG_MAGIC, sizeof(RIG_MAGIC));
+    header.version = RIG_VERSION;
+    header.numBones = numBones;
+    header.stringTableSize = strings.size();
+
+    std::ofstream file(filename.c_str(), std::ios::binary);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(&parents_[0]), numBones * sizeof(int32_t));
+    file.write(reinterpret_cast<const char *>(&subtreeEnd_[0]), numBones * sizeof(int32_t));
+    file.write(reinterpret_cast<const char *>(&nameOffsets[0]), numBones * sizeof(uint32_t));
+    file.write(reinterpret_cast<const char *>(&positions_[0]), numBones * sizeof(glm::vec3));
+    file.write(reinterpret_cast<const char *>(&lengths[0]), numBones * sizeof(float));
+    file.write(reinterpret_cast<const char *>(&rotations[0]), numBones * sizeof(glm::vec4));
+    file.write(strings.data(), strings.size());
+
+    if (!file)
+    {
+        std::cerr << "Unable to write rig file: " << filename << '\n';
+        return false;
+    }
+    return true;
+}
+
+bool Rig::readBinaryRig(const char *data, size_t size, const std::string &filename)
+{
+    RigFileHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (header.version != RIG_VERSION || header.numBones == 0 ||
+            size < rigFileSize(header.numBones, header.stringTableSize))
+    {
+        std::cerr << "Bad binary rig file: " << filename << '\n';
+        return false;
+    }
+
+    const size_t numBones = header.numBones;
+    const char *cur = data + sizeof(header);
+
+    parents_.resize(numBones);
+    subtreeEnd_.resize(numBones);
+    std::vector<uint32_t> nameOffsets(numBones);
+    positions_.resize(numBones);
+    std::vector<float> lengths(numBones);
+    std::vector<glm::vec4> rotations(numBones);
+
+    memcpy(&parents_[0], cur, numBones * sizeof(int32_t));
+    cur += numBones * sizeof(int32_t);
+    memcpy(&subtreeEnd_[0], cur, numBones * sizeof(int32_t));
+    cur += numBones * sizeof(int32_t);
+    memcpy(&nameOffsets[0], cur, numBones * sizeof(uint32_t));
+    cur += numBones * sizeof(uint32_t);
+    memcpy(static_cast<void *>(&positions_[0]), cur, numBones * sizeof(glm::vec3));
+    cur += numBones * sizeof(glm::vec3);
+    memcpy(&lengths[0], cur, numBones * sizeof(float));
+    cur += numBones * sizeof(float);
+    memcpy(static_cast<void *>(&rotations[0]), cur, numBones * sizeof(glm::vec4));
+    cur += numBones * sizeof(glm::vec4);
+    const char *strings = cur;
+
+    // Everything downstream relies on the depth first order, check it
+    // before any of it is used: parents come first, subtrees are
+    // contiguous and nest in their parent's, names end inside the table
+    for (size_t i = 0; i < numBones; i++)
+    {
+        const int parent = parents_[i];
+        const int end = subtreeEnd_[i];
+        bool ok = i == 0 ? parent == -1 : parent >= 0 && parent < static_cast<int>(i);
+        ok = ok && end > static_cast<int>(i) && end <= static_cast<int>(numBones);
+        ok = ok && (parent < 0 || end <= subtreeEnd_[parent]);
+        ok = ok && nameOffsets[i] < header.stringTableSize &&
+            memchr(strings + nameOffsets[i], '\0',
+                    header.stringTableSize - nameOffsets[i]) != NULL;
+        if (!ok)
+        {
+            std::cerr << "Bad binary rig file: " << filename << ", bone " << i << '\n';
+            return false;
+        }
+    }
+
+    names_.resize(numBones);
+    refPose_.resize(numBones);
+    boneIndex_.clear();
+    for (size_t i = 0; i < numBones; i++)
+    {
+        names_[i] = strings + nameOffsets[i];
+        boneIndex_[names_[i]] = i;
+
+        const glm::vec4 &r = rotations[i];
+        refPose_[i].length = lengths[i];
+        refPose_[i].rot = glm::quat(r.w, r.x, r.y, r.z);
+    }
+    return true;
+}
+
+void Rig::readTextRig(const std::string &filename)
+{
+    std::ifstream file(filename.c_str());
+
+    names_.clear();
+    positions_.clear();
+    refPose_.clear();
+
+    std::vector<std::string> parentnames;
+    std::string line;
+    while (std::getline(file, line))
+        readBone(line, parentnames);
+
+    sortBones(parentnames);
+}
+
+void Rig::printRig(std::ostream &os) const
+{
+    for (size_t i = 0; i < names_.size(); i++)
+    {
+        const glm::vec3 &pos = positions_[i];
+        const glm::vec4 rot = quatToAxisAngle(refPose_[i].rot);
+        os  << names_[i] << ' ' << pos[0] << ' ' << pos[1] << ' ' << pos[2] << ' '
+            << rot[0] << ' ' << rot[1] << ' ' << rot[2] << ' ' << rot[3] << ' '
+            << refPose_[i].length << ' '
+            << (parents_[i] < 0 ? "NULL" : names_[parents_[i]]) << '\n';
+    }
+}
+
+int Rig::getBoneIndex(const std::string &name) const
+{
+    std::map<std::string, int>::const_iterator it = boneIndex_.find(name);
+    if (it == boneIndex_.end())
+        return -1;
+    return it->second;
+}
+
+glm::vec3 Rig::getBoneOffset(const BoneFrame *pose, int bone) const
+{
+    // Bones start at the tip of their parent, offset by their position
+    const int parent = parents_[bone];
+    if (parent < 0)
+        return positions_[bone];
+    return glm::vec3(pose[parent].length, 0.f, 0.f) + positions_[bone];
+}
+
+void Rig::computePalette(const BoneFrame *pose, const glm::mat4 &root,
+        glm::mat4 *out) const
+{
+    for (size_t i = 0; i < names_.size(); i++)
+    {
+        const int parent = parents_[i];
+
+        const glm::mat4 &parentTransform = parent < 0 ? root : out[parent];
+        glm::mat4 transform = glm::translate(parentTransform, getBoneOffset(pose, i));
+
+        out[i] = transform * glm::mat4_cast(pose[i].rot);
+    }
+}
+
+void Rig::readBone(const std::string &bonestr, std::vector<std::string> &parentnames)
+{
+    std::stringstream ss(bonestr);
+    std::string name, parentname;
+    float x, y, z, a, rotx, roty, rotz, length;
+    ss >> name >> x >> y >> z >> rotx >> roty >> rotz >> a >> length >> parentname;
+    if (!ss)
+    {
+        std::cerr << "Could not read bone from string: '" << bonestr << "'\n";
+        assert(false);
+    }
+
+    if (parentname == "NULL")
+        assert(name == "root");
+
+    // Parents are resolved in sortBones, once every bone has been read
+    BoneFrame bf;
+    bf.length = length;
+    bf.rot = axisAngleToQuat(glm::vec4(rotx, roty, rotz, a));
+
+    names_.push_back(name);
+    positions_.push_back(glm::vec3(x, y, z));
+    refPose_.push_back(bf);
+    parentnames.push_back(parentname);
+}
+
+void Rig::sortBones(const std::vector<std::string> &parentnames)
+{
+    const size_t numBones = names_.size();
+
+    // Resolve parents and children in file order
+    std::map<std::string, int> fileIndex;
+    for (size_t i = 0; i < numBones; i++)
+        fileIndex[names_[i]] = i;
+
+    int root = -1;
+    std::vector<std::vector<int> > children(numBones);
+    for (size_t i = 0; i < numBones; i++)
+    {
+        if (parentnames[i] == "NULL")
+        {
+            assert(root == -1);
+            root = i;
+            continue;
+        }
+        assert(fileIndex.find(parentnames[i]) != fileIndex.end());
+        children[fileIndex[parentnames[i]]].push_back(i);
+    }
+    assert(root >= 0);
+
+    // Depth first walk from the root gives the new order, parents first
+    std::vector<int> order;
+    std::vector<int> fileParents(numBones, -1);
+    std::vector<int> stack(1, root);
+    while (!stack.empty())
+    {
+        int cur = stack.back();
+        stack.pop_back();
+        order.push_back(cur);
+
+        for (size_t i = children[cur].size(); i > 0; i--)
+        {
+            fileParents[children[cur][i - 1]] = cur;
+            stack.push_back(children[cur][i - 1]);
+        }
+    }
+    assert(order.size() == numBones);
+
+    std::vector<int> newIndex(numBones);
+    for (size_t i = 0; i < numBones; i++)
+        newIndex[order[i]] = i;
+
+    std::vector<std::string> names(numBones);
+    std::vector<glm::vec3> positions(numBones);
+    std::vector<BoneFrame> refPose(numBones);
+    parents_.assign(numBones, -1);
+    boneIndex_.clear();
+    for (size_t i = 0; i < numBones; i++)
+    {
+        int old = order[i];
+        names[i] = names_[old];
+        positions[i] = positions_[old];
+        refPose[i] = refPose_[old];
+        if (fileParents[old] >= 0)
+            parents_[i] = newIndex[fileParents[old]];
+        boneIndex_[names[i]] = i;
+    }
+
+    names_.swap(names);
+    positions_.swap(positions);
+    refPose_.swap(refPose);
+
+    // Children come after their parent, so walking backwards every subtree
+    // is finished before it is folded into its parent's
+    subtreeEnd_.resize(numBones);
+    for (size_t i = 0; i < numBones; i++)
+        subtreeEnd_[i] = i + 1;
+    for (size_t i = numBones; i > 1; i--)
+    {
+        int parent = parents_[i - 1];
+        subtreeEnd_[parent] = std::max(subtreeEnd_[parent], subtreeEnd_[i - 1]);
+    }
+}
+
+glm::quat axisAngleToQuat(const glm::vec4 &rot)
+{
+    glm::vec3 axis(rot);
+    float axislen = glm::length(axis);
+    if (axislen == 0.f)
+        return glm::quat();
+
+    float rad = glm::radians(rot[3]) / 2.f;
+    return glm::quat(cosf(rad), axis * (sinf(rad) / axislen));
+}
+
+glm::vec4 quatToAxisAngle(const glm::quat &q)
+{
+    float w = glm::clamp(q.w, -1.f, 1.f);
+    float s = sqrtf(1.f - w * w);
+    // No rotation, any axis will do
+    if (s < 1e-6f)
+        return glm::vec4(0.f, 0.f, 1.f, 0.f);
+
+    return glm::vec4(q.x / s, q.y / s, q.z / s, glm::degrees(2.f * acosf(w)));
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <string>
+#include <map>
+#include <vector>
+#include <iostream>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+struct BoneFrame
+{
+    float length;
+    // unit quaternion
+    glm::quat rot;
+};
+
+// The file formats store rotations as x,y,z, angle (degrees), they are only
+// converted to and from quaternions when reading and writing
+glm::quat axisAngleToQuat(const glm::vec4 &rot);
+glm::vec4 quatToAxisAngle(const glm::quat &q);
+
+// The bone hierarchy, read once and then shared by every skeleton or crowd
+// instance that animates it.  Poses are passed around as arrays of
+// BoneFrames with one entry per bone, in bone index order.
+class Rig
+{
+public:
+    // Reads either a .bones text file or a binary rig written by writeRig.
+    // Returns false and leaves the rig empty if the file can't be opened or
+    // a binary rig is malformed.
+    bool readRig(const std::string &filename);
+    // Writes the rig back out in the .bones text format
+    void printRig(std::ostream &os) const;
+    // Writes the binary rig format, bones already sorted, see rig.cpp
+    bool writeRig(const std::string &filename) const;
+
+    size_t numBones() const { return names_.size(); }
+
+    // Bone handles, resolve names once and use the index everywhere else.
+    // getBoneIndex returns -1 for unknown names.
+    int getBoneIndex(const std::string &name) const;
+    const std::string &getBoneName(int bone) const { return names_[bone]; }
+    int getParent(int bone) const { return parents_[bone]; }
+    // One past the last bone of the subtree rooted at bone
+    int getSubtreeEnd(int bone) const { return subtreeEnd_[bone]; }
+
+    // Original, reference pose, stored when read in from file
+    const std::vector<BoneFrame> &getRefPose() const { return refPose_; }
+
+    // Offset of a bone's base from its parent's base, in parent space
+    glm::vec3 getBoneOffset(const BoneFrame *pose, int bone) const;
+    // Fills out[0..numBones()) with the model space transform of each bone's
+    // base, every matrix is built from its parent's entry.
+    void computePalette(const BoneFrame *pose, const glm::mat4 &root,
+            glm::mat4 *out) const;
+
+private:
+    // Bones are stored as flat parallel arrays, sorted depth first so that
+    // every parent comes before its children.  The root is always index 0.
+    std::vector<std::string> names_;
+    // index of the parent bone, -1 for the root
+    std::vector<int> parents_;
+    // position relative to the parent's tip
+    std::vector<glm::vec3> positions_;
+    // One past the last bone of each bone's subtree, the depth first order
+    // keeps every subtree contiguous
+    std::vector<int> subtreeEnd_;
+    std::vector<BoneFrame> refPose_;
+    // Bone name -> index into the arrays above
+    std::map<std::string, int> boneIndex_;
+
+    void readTextRig(const std::string &filename);
+    bool readBinaryRig(const char *data, size_t size, const std::string &filename);
+    void clear();
+    void readBone(const std::string &bonestr, std::vector<std::string> &parentnames);
+    void sortBones(const std::vector<std::string> &parentnames);
+};
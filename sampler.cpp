@@ -0,0 +1,151 @@
+#include "sampler.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+#include <glm/gtx/simd_vec4.hpp>
+#endif
+
+const size_t PoseSampler::LANES;
+const size_t PoseSampler::BLOCK_FLOATS;
+
+// Lane offsets inside a block
+enum { LANE_X = 0, LANE_Y = 4, LANE_Z = 8, LANE_W = 12, LANE_LENGTH = 16 };
+
+// Scatters the first count bones of a block into out
+static void storeBlock(const float *block, size_t count, BoneFrame *out)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        out[i].rot = glm::quat(block[LANE_W + i], block[LANE_X + i],
+                block[LANE_Y + i], block[LANE_Z + i]);
+        out[i].length = block[LANE_LENGTH + i];
+    }
+}
+
+PoseSampler::PoseSampler() :
+    numBones_(0), numBlocks_(0), numframes_(0)
+{
+}
+
+void PoseSampler::build(const Animation &anim)
+{
+    assert(!anim.keyframes.empty());
+
+    const size_t numKeys = anim.keyframes.size();
+    numBones_ = anim.keyframes[0].bones.size();
+    numBlocks_ = (numBones_ + LANES - 1) / LANES;
+    numframes_ = anim.numframes;
+    keyFrames_.resize(numKeys);
+    keys_.assign(numKeys * numBlocks_ * BLOCK_FLOATS, 0.f);
+
+    for (size_t k = 0; k < numKeys; k++)
+    {
+        const Keyframe &kf = anim.keyframes[k];
+        assert(kf.bones.size() == numBones_);
+        keyFrames_[k] = kf.frame;
+
+        float *key = &keys_[k * numBlocks_ * BLOCK_FLOATS];
+        for (size_t blk = 0; blk < numBlocks_; blk++)
+        {
+            float *block = key + blk * BLOCK_FLOATS;
+            for (size_t i = 0; i < LANES; i++)
+            {
+                // Padding lanes hold the identity so they normalize cleanly
+                const size_t bone = blk * LANES + i;
+                if (bone >= numBones_)
+                {
+                    block[LANE_W + i] = 1.f;
+                    continue;
+                }
+
+                const BoneFrame &bf = kf.bones[bone];
+                block[LANE_X + i] = bf.rot.x;
+                block[LANE_Y + i] = bf.rot.y;
+                block[LANE_Z + i] = bf.rot.z;
+                block[LANE_W + i] = bf.rot.w;
+                block[LANE_LENGTH + i] = bf.length;
+            }
+        }
+    }
+}
+
+void PoseSampler::copyKey(size_t key, BoneFrame *out) const
+{
+    const float *k = getKey(key);
+    for (size_t blk = 0; blk < numBlocks_; blk++)
+        storeBlock(k + blk * BLOCK_FLOATS,
+                std::min(LANES, numBones_ - blk * LANES), out + blk * LANES);
+}
+
+void PoseSampler::samplePose(float frame, BoneFrame *out, AnimCursor *cursor) const
+{
+    assert(!keyFrames_.empty());
+
+    size_t k0, k1;
+    float fact;
+    if (!selectKeys(&keyFrames_[0], keyFrames_.size(), numframes_, frame, cursor,
+                &k0, &k1, &fact))
+    {
+        copyKey(k0, out);
+        return;
+    }
+
+    const float *ka = getKey(k0);
+    const float *kb = getKey(k1);
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+    // nlerp four bones per iteration, loads are unaligned since the key
+    // storage is a plain float vector
+    const glm::simdVec4 fa(1.f - fact), fb(fact);
+    for (size_t blk = 0; blk < numBlocks_; blk++)
+    {
+        const float *a = ka + blk * BLOCK_FLOATS;
+        const float *b = kb + blk * BLOCK_FLOATS;
+
+        glm::simdVec4 x = glm::simdVec4(_mm_loadu_ps(a + LANE_X)) * fa +
+            glm::simdVec4(_mm_loadu_ps(b + LANE_X)) * fb;
+        glm::simdVec4 y = glm::simdVec4(_mm_loadu_ps(a + LANE_Y)) * fa +
+            glm::simdVec4(_mm_loadu_ps(b + LANE_Y)) * fb;
+        glm::simdVec4 z = glm::simdVec4(_mm_loadu_ps(a + LANE_Z)) * fa +
+            glm::simdVec4(_mm_loadu_ps(b + LANE_Z)) * fb;
+        glm::simdVec4 w = glm::simdVec4(_mm_loadu_ps(a + LANE_W)) * fa +
+            glm::simdVec4(_mm_loadu_ps(b + LANE_W)) * fb;
+        glm::simdVec4 len = glm::simdVec4(_mm_loadu_ps(a + LANE_LENGTH)) * fa +
+            glm::simdVec4(_mm_loadu_ps(b + LANE_LENGTH)) * fb;
+        glm::simdVec4 inv = glm::inversesqrt(x * x + y * y + z * z + w * w);
+
+        float block[BLOCK_FLOATS];
+        _mm_storeu_ps(block + LANE_X, (x * inv).Data);
+        _mm_storeu_ps(block + LANE_Y, (y * inv).Data);
+        _mm_storeu_ps(block + LANE_Z, (z * inv).Data);
+        _mm_storeu_ps(block + LANE_W, (w * inv).Data);
+        _mm_storeu_ps(block + LANE_LENGTH, len.Data);
+
+        storeBlock(block, std::min(LANES, numBones_ - blk * LANES), out + blk * LANES);
+    }
+#else
+    for (size_t blk = 0; blk < numBlocks_; blk++)
+    {
+        const float *a = ka + blk * BLOCK_FLOATS;
+        const float *b = kb + blk * BLOCK_FLOATS;
+
+        float block[BLOCK_FLOATS];
+        for (size_t l = 0; l < BLOCK_FLOATS; l++)
+            block[l] = a[l] * (1.f - fact) + b[l] * fact;
+        for (size_t l = 0; l < LANES; l++)
+        {
+            float inv = 1.f / sqrtf(block[LANE_X + l] * block[LANE_X + l] +
+                    block[LANE_Y + l] * block[LANE_Y + l] +
+                    block[LANE_Z + l] * block[LANE_Z + l] +
+                    block[LANE_W + l] * block[LANE_W + l]);
+            block[LANE_X + l] *= inv;
+            block[LANE_Y + l] *= inv;
+            block[LANE_Z + l] *= inv;
+            block[LANE_W + l] *= inv;
+        }
+
+        storeBlock(block, std::min(LANES, numBones_ - blk * LANES), out + blk * LANES);
+    }
+#endif
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+#include "rig.h"
+#include "animation.h"
+
+// An Animation transposed for vector sampling.  Every key stores its bones
+// in blocks of four, each block five lanes of x, y, z, w and length, so
+// one nlerp works on four bones at once.  Sampling writes into a caller
+// provided pose and never allocates.
+class PoseSampler
+{
+public:
+    // Bones per block, the SIMD width
+    static const size_t LANES = 4;
+
+    PoseSampler();
+
+    // anim must have at least one keyframe, sorted by frame
+    void build(const Animation &anim);
+
+    size_t numBones() const { return numBones_; }
+    size_t numKeys() const { return keyFrames_.size(); }
+
+    // Same behaviour as samplePose on the source Animation
+    void samplePose(float frame, BoneFrame *out, AnimCursor *cursor = NULL) const;
+
+private:
+    // floats per block of LANES bones
+    static const size_t BLOCK_FLOATS = 5 * LANES;
+
+    size_t numBones_;
+    size_t numBlocks_;
+    int numframes_;
+    std::vector<int> keyFrames_;
+    // numKeys * numBlocks blocks
+    std::vector<float> keys_;
+
+    const float *getKey(size_t key) const { return &keys_[key * numBlocks_ * BLOCK_FLOATS]; }
+    void copyKey(size_t key, BoneFrame *out) const;
+};
@@ -0,0 +1,150 @@
+#include "spline.h"
+#include <cassert>
+#include <cmath>
+
+// The squad and intermediate helpers in the bundled glm don't compile or
+// get the maths wrong, so these are done here.
+
+// Log of a unit quaternion, a pure quaternion (0, axis * half angle)
+static glm::quat quatLog(const glm::quat &q)
+{
+    glm::vec3 v(q.x, q.y, q.z);
+    float s = glm::length(v);
+    if (s < 1e-6f)
+        return glm::quat(0.f, v);
+    float angle = atan2f(s, q.w);
+    return glm::quat(0.f, v * (angle / s));
+}
+
+// Exp of a pure quaternion, the inverse of quatLog
+static glm::quat quatExp(const glm::quat &q)
+{
+    glm::vec3 v(q.x, q.y, q.z);
+    float angle = glm::length(v);
+    if (angle < 1e-6f)
+        return glm::normalize(glm::quat(1.f, v));
+    return glm::quat(cosf(angle), v * (sinf(angle) / angle));
+}
+
+// Slerp without the shortest path flip, squad relies on that
+static glm::quat slerp(const glm::quat &a, const glm::quat &b, float t)
+{
+    float cosAngle = glm::dot(a, b);
+    // Too close for sin to be accurate, nlerp is indistinguishable
+    if (fabsf(cosAngle) > 0.9995f)
+        return glm::normalize(a * (1.f - t) + b * t);
+
+    float angle = acosf(glm::clamp(cosAngle, -1.f, 1.f));
+    float inv = 1.f / sinf(angle);
+    return a * (sinf((1.f - t) * angle) * inv) + b * (sinf(t * angle) * inv);
+}
+
+static glm::quat squad(const glm::quat &q1, const glm::quat &q2,
+        const glm::quat &s1, const glm::quat &s2, float h)
+{
+    return slerp(slerp(q1, q2, h), slerp(s1, s2, h), 2.f * h * (1.f - h));
+}
+
+// Control point between prev and next that keeps the rotation C1 at curr
+static glm::quat intermediate(const glm::quat &prev, const glm::quat &curr,
+        const glm::quat &next)
+{
+    glm::quat inv = glm::conjugate(curr);
+    glm::quat sum = quatLog(inv * next);
+    glm::quat logPrev = quatLog(inv * prev);
+    sum.x += logPrev.x;
+    sum.y += logPrev.y;
+    sum.z += logPrev.z;
+    return glm::normalize(curr * quatExp(sum * -0.25f));
+}
+
+SplineClip::SplineClip() :
+    numBones_(0), numframes_(0)
+{
+}
+
+void SplineClip::build(const Animation &anim)
+{
+    assert(!anim.keyframes.empty());
+
+    const size_t numKeys = anim.keyframes.size();
+    numBones_ = anim.keyframes[0].bones.size();
+    numframes_ = anim.numframes;
+    keyFrames_.resize(numKeys);
+    keys_.resize(numKeys * numBones_);
+
+    for (size_t k = 0; k < numKeys; k++)
+    {
+        const Keyframe &kf = anim.keyframes[k];
+        assert(kf.bones.size() == numBones_);
+        keyFrames_[k] = kf.frame;
+
+        for (size_t b = 0; b < numBones_; b++)
+        {
+            SplineKey &key = keys_[k * numBones_ + b];
+            key.rot = kf.bones[b].rot;
+            key.length = kf.bones[b].length;
+            if (k > 0 && glm::dot(keys_[(k - 1) * numBones_ + b].rot, key.rot) < 0.f)
+                key.rot = -key.rot;
+        }
+    }
+
+    for (size_t k = 0; k < numKeys; k++)
+    {
+        // End keys use the one sided difference and the key itself as the
+        // intermediate, the curve then starts and ends like a slerp
+        const size_t prev = k > 0 ? k - 1 : k;
+        const size_t next = k + 1 < numKeys ? k + 1 : k;
+        const float span = keyFrames_[next] - keyFrames_[prev];
+
+        for (size_t b = 0; b < numBones_; b++)
+        {
+            SplineKey &key = keys_[k * numBones_ + b];
+            const SplineKey &p = keys_[prev * numBones_ + b];
+            const SplineKey &n = keys_[next * numBones_ + b];
+
+            key.tangent = span > 0.f ? (n.length - p.length) / span : 0.f;
+            key.inter = (prev == k || next == k) ? key.rot :
+                intermediate(p.rot, key.rot, n.rot);
+        }
+    }
+}
+
+void SplineClip::samplePose(float frame, BoneFrame *out, AnimCursor *cursor) const
+{
+    assert(!keyFrames_.empty());
+
+    size_t k0, k1;
+    float h;
+    if (!selectKeys(&keyFrames_[0], keyFrames_.size(), numframes_, frame, cursor,
+                &k0, &k1, &h))
+    {
+        const SplineKey *key = getKey(k0);
+        for (size_t b = 0; b < numBones_; b++)
+        {
+            out[b].rot = key[b].rot;
+            out[b].length = key[b].length;
+        }
+        return;
+    }
+
+    const float span = keyFrames_[k1] - keyFrames_[k0];
+    const SplineKey *ka = getKey(k0);
+    const SplineKey *kb = getKey(k1);
+
+    // Cubic Hermite basis, tangents are per frame so scale by the span
+    const float h2 = h * h, h3 = h2 * h;
+    const float f0 = 2.f * h3 - 3.f * h2 + 1.f;
+    const float f1 = -2.f * h3 + 3.f * h2;
+    const float t0 = (h3 - 2.f * h2 + h) * span;
+    const float t1 = (h3 - h2) * span;
+
+    for (size_t b = 0; b < numBones_; b++)
+    {
+        const SplineKey &a = ka[b];
+        const SplineKey &c = kb[b];
+
+        out[b].rot = glm::normalize(squad(a.rot, c.rot, a.inter, c.inter, h));
+        out[b].length = f0 * a.length + f1 * c.length + t0 * a.tangent + t1 * c.tangent;
+    }
+}
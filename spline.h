@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include "rig.h"
+#include "animation.h"
+
+// An Animation interpolated with splines instead of nlerp.  Rotations use
+// squad through each key's intermediate quaternion, lengths a Catmull-Rom
+// style cubic Hermite whose tangents account for uneven key spacing.  The
+// intermediates and tangents are computed once in build, sampling only
+// evaluates the curves, so sparse keys still play back smoothly.
+class SplineClip
+{
+public:
+    SplineClip();
+
+    // anim must have at least one keyframe, sorted by frame
+    void build(const Animation &anim);
+
+    size_t numBones() const { return numBones_; }
+    size_t numKeys() const { return keyFrames_.size(); }
+
+    // Passes through every key like samplePose on the source Animation,
+    // and holds the end keys the same way
+    void samplePose(float frame, BoneFrame *out, AnimCursor *cursor = NULL) const;
+
+private:
+    struct SplineKey
+    {
+        // rot is flipped into the hemisphere of the previous key so squad
+        // takes the short way round
+        glm::quat rot;
+        glm::quat inter;
+        float length;
+        // d length / d frame
+        float tangent;
+    };
+
+    size_t numBones_;
+    int numframes_;
+    std::vector<int> keyFrames_;
+    // numKeys * numBones, key major
+    std::vector<SplineKey> keys_;
+
+    const SplineKey *getKey(size_t key) const { return &keys_[key * numBones_]; }
+};
@@ -13,6 +13,9 @@
 #include <GL/glut.h>
 #endif
 
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
 #include "uistate.h"
 #include "util.h"
 
@@ -31,6 +34,8 @@ p_aspect( 1 ),
 p_near( 1 / sinf( Deg2Rad( 25 ) ) ),
 p_far( 1 / sinf( Deg2Rad( 25 ) ) + 2 ),
 p_fov( 50 ),
+p_view( 1.f ),
+p_proj( 1.f ),
 p_ball()
 {
 }
@@ -41,29 +46,38 @@ UIState::SetupViewport( void )
     glViewport( 0, 0, p_windowx, p_windowy );
 }
 
+void
+UIState::UpdateProjectionMatrix( void )
+{
+    p_proj = glm::perspective( p_fov / std::min( 1.f, p_aspect ), p_aspect, p_near, p_far );
+}
+
 void
 UIState::SetupViewingFrustum( void )
 {
+    UpdateProjectionMatrix();
     glMatrixMode( GL_PROJECTION );
-    glLoadIdentity();
-    gluPerspective( p_fov / std::min( 1.f, p_aspect ), p_aspect, p_near, p_far );
+    glLoadMatrixf( glm::value_ptr( p_proj ) );
     glMatrixMode( GL_MODELVIEW );
 }
 
 void
-UIState::ApplyViewingTransformation( void )
+UIState::UpdateViewMatrix( void )
 {
-    glMatrixMode( GL_MODELVIEW );
-    glLoadIdentity();
-    glTranslatef( p_ctrans.x, p_ctrans.y, p_ctrans.z );
-    
-    GLfloat M[4][4];
     p_ball.Update();
-    p_ball.Value( M );
+    p_view = glm::translate( glm::mat4( 1.f ), p_ctrans );
     // apply model transform
-    glMultMatrixf( ( float *)M );
+    p_view *= p_ball.Value();
     // move world to the origin
-    glTranslatef( -p_trans.x, -p_trans.y, -p_trans.z );
+    p_view = glm::translate( p_view, -p_trans );
+}
+
+void
+UIState::ApplyViewingTransformation( void )
+{
+    UpdateViewMatrix();
+    glMatrixMode( GL_MODELVIEW );
+    glLoadMatrixf( glm::value_ptr( p_view ) );
 }
 
 void
@@ -33,6 +33,10 @@ public:
     float& Near( void ) { return p_near; }
     float& Far( void ) { return p_far; }
     float& Fov( void ) { return p_fov; }
+    // camera matrices, kept on the CPU so they never need to be read
+    // back from GL
+    const glm::mat4& ViewMatrix( void ) const { return p_view; }
+    const glm::mat4& ProjectionMatrix( void ) const { return p_proj; }
     void MouseFunction(const int button, const int state, const int x, const int y);
     void MotionFunction(const int x, const int y);
     enum{
@@ -61,6 +65,10 @@ public:
     
     // methods
     void ResetModelTransform( void );
+    // rebuild the camera matrices without touching GL
+    void UpdateViewMatrix( void );
+    void UpdateProjectionMatrix( void );
+    // the same, then load them into GL
     void ApplyViewingTransformation( void );
     void SetupViewingFrustum( void );
     void SetupViewport( void );
@@ -98,6 +106,8 @@ private:
     float p_near;
     float p_far;
     float p_fov;
+    glm::mat4 p_view;
+    glm::mat4 p_proj;
     
     // arcball interface
     ArcBall p_ball;